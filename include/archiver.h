@@ -1,17 +1,91 @@
 #ifndef ARCHIVER_H
 #define ARCHIVER_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
+#include "callbacks.h"
+#include "canonicalCode.h"
 #include "errors.h"
 
+class Manifest;
+
+// Settings for building and reading compressed archives
+struct ArchiveOptions {
+    unsigned threads = 0;  // Worker threads; 0 means one per hardware thread
+    int maxCodeLength = CanonicalCode::DEFAULT_MAX_CODE_LENGTH;
+    bool solid = true;     // Code small files in groups sharing one table (native archives)
+    bool verifyContents = false;  // Updates: also compare checksums of files whose size and time match
+    LogCallback logger;
+    ProgressCallback progress;
+};
+
+// One member of a native archive, as recorded in its central directory
+struct ArchiveEntry {
+    uint8_t flags = 0;
+    std::string name;         // Relative, '/'-separated
+    uint64_t size = 0;        // Original size
+    uint32_t crc = 0;         // CRC-32 of the original data
+    uint64_t offset = 0;      // Where the member starts in the archive
+    uint64_t storedSize = 0;  // Bytes the member takes in the archive
+    uint64_t source = 0;      // For duplicates and solid members (HPA_MEMBER_*): index of the entry
+                              // with the data or the shared table
+    int64_t modified = 0;     // Modification time of the file, nanoseconds since the Unix epoch
+                              // (0 in archives before version 3)
+};
+
 class Archiver {
 public:
     // Bundles a directory into a single output file
     static ErrorCode archiveDirectory(const std::string& directoryPath, const std::string& outputFilename);
 
-    // Extracts an archive file to a directory
-    static ErrorCode extractArchive(const std::string& archiveFilename, const std::string& outputDirectory);
+    // Compresses a directory into a native .hpa archive: every file is coded
+    // with its own tables, block by block on a thread pool, and written
+    // straight into the archive in a deterministic order. Files with the same
+    // contents as an earlier one are stored once and referenced after that,
+    // and small files of the same type share one table in solid groups.
+    static ErrorCode compressDirectory(const std::string& directoryPath, const std::string& outputFilename,
+                                       const ArchiveOptions& options = {});
+
+    // Same, for a directory a caller has already scanned, so the tree is not
+    // walked a second time
+    static ErrorCode compressDirectory(const Manifest& manifest, const std::string& outputFilename,
+                                       const ArchiveOptions& options = {});
+
+    // Brings the native archive `archiveFilename` up to date with a directory.
+    // Files whose size and modification time (and with verifyContents, CRC-32)
+    // match the archive's directory are not recompressed: their coded bytes
+    // are copied from the old archive, so the work done follows what changed.
+    // The new archive is written next to the old one and replaces it when
+    // complete; without an old archive to update, this is compressDirectory.
+    static ErrorCode updateArchive(const std::string& directoryPath, const std::string& archiveFilename,
+                                   const ArchiveOptions& options = {});
+
+    // Extracts an archive file to a directory: a native .hpa archive, or a
+    // bundle written by archiveDirectory, as it is or compressed as a whole.
+    // A compressed bundle is decoded straight into the extractor through a
+    // bounded in-memory pipe, never to a temporary file. Native members are
+    // checked against the central directory when the archive has one.
+    static ErrorCode extractArchive(const std::string& archiveFilename, const std::string& outputDirectory,
+                                    const ArchiveOptions& options = {});
+
+    // Reads the member list from the central directory of a native archive,
+    // without touching the members themselves
+    static ErrorCode listArchive(const std::string& archiveFilename, std::vector<ArchiveEntry>& entries);
+
+    // Extracts the member stored as `memberName` to `outputFilename`. Only the
+    // central directory and that member are read, and the result is checked
+    // against the stored CRC-32.
+    static ErrorCode extractMember(const std::string& archiveFilename, const std::string& memberName,
+                                   const std::string& outputFilename, const ArchiveOptions& options = {});
+
+    // True if the file starts like a native .hpa archive
+    static bool isNativeArchive(const std::string& filename);
+
+    // True if the file is an archive in the earlier layout: a bundle written by
+    // archiveDirectory, or one compressed as a single .hpf stream. Only the
+    // first bytes of a compressed file are decoded to tell.
+    static bool isLegacyArchive(const std::string& filename);
 };
 
 #endif // ARCHIVER_H
@@ -3,14 +3,24 @@
 
 #include <istream>
 #include <vector>
+#include <cstdint>
+#include "inputSource.h"
 
-// BitReader is a utility class for reading individual bits or bytes from an input stream.
-// It buffers data byte-by-byte and provides bitwise access for decoding purposes.
+// BitReader is a utility class for reading individual bits or bytes from an input stream
+// or a memory buffer. Bits are served MSB first from a 64-bit buffer that is refilled a
+// whole word at a time (from a 64KB block of the stream in stream mode), so decoders can
+// peek several bits at once.
 class BitReader {
 public:
     // Constructor binds the BitReader to an existing input stream
     explicit BitReader(std::istream& input);
 
+    // Reads from a memory buffer that must outlive the reader
+    BitReader(const unsigned char* data, size_t size);
+
+    // Reads a freshly opened source: straight from its mapping when it has one
+    explicit BitReader(InputSource& source);
+
     // Reads the next single bit from the input stream.
     // Returns true if a bit was successfully read, false on failure (EOF or error).
     bool readBit(bool& bit);
@@ -19,19 +29,78 @@ public:
     // Useful for reading characters during tree deserialization.
     bool readByte(unsigned char& byte);
 
+    // Reads the next `count` bits (1..32) as an integer, MSB first.
+    // Returns false, consuming nothing, if fewer than `count` bits remain.
+    bool readBits(int count, uint32_t& value);
+
+    // Returns the next `count` bits (1..32, MSB first) without consuming them.
+    // Bits past the end of the stream read as 0; `available` receives how many are real.
+    // Defined inline: decoders call it once per symbol.
+    uint32_t peekBits(int count, int& available) {
+        if (bitCount < count) refill();
+        available = bitCount < count ? bitCount : count;
+        return static_cast<uint32_t>(bitBuffer >> (64 - count));
+    }
+
+    // Same for up to 56 bits, which a refill always brings in while the input lasts
+    uint64_t peekWideBits(int count, int& available) {
+        if (bitCount < count) refill();
+        available = bitCount < count ? bitCount : count;
+        return bitBuffer >> (64 - count);
+    }
+
+    // Discards `count` bits (at most what peekBits() reported as available)
+    void consumeBits(int count) {
+        bitBuffer <<= count;
+        bitCount -= count;
+    }
+
+    // Copies the next `count` whole bytes out. The reader must be byte aligned.
+    bool readBytes(unsigned char* dest, size_t count);
+
+    // Points `span` at the next `count` whole bytes. In memory mode that is the
+    // input itself; a stream is copied into `scratch`. The reader must be byte aligned.
+    bool readSpan(const unsigned char*& span, size_t count, std::vector<unsigned char>& scratch);
+
     // Aligns the bit reader to the next full byte boundary by discarding leftover bits
     void alignToByte();
 
+    // Tops bitBuffer up to at least 56 bits, or as far as the input allows.
+    // While 8 bytes are buffered this is one unaligned big-endian load with no
+    // data-dependent branch: bytes beyond the ones counted land below the valid
+    // bits and are loaded again, identically, next time.
+    void refill() {
+        if (end - cursor < 8) {
+            refillSlow();
+            return;
+        }
+        uint64_t word = 0;
+        for (int i = 0; i < 8; ++i) {
+            word = (word << 8) | cursor[i];  // Compiles to a load + byte swap
+        }
+        bitBuffer |= word >> bitCount;
+        cursor += (63 - bitCount) >> 3;
+        bitCount |= 56;
+    }
+
+    // Memory mode: the next unread byte. The reader must be byte aligned.
+    const unsigned char* bytePosition() const {
+        return cursor - bitCount / 8;
+    }
+
 private:
-    std::istream& inputStream;     // Reference to the input file/stream
-    unsigned char currentByte = 0; // Buffer to store a byte being read bit-by-bit
-    int bitsRemaining = 0;         // How many bits are left to read from the current buffer
+    std::istream* inputStream;     // Input file/stream, or nullptr when reading memory
+    uint64_t bitBuffer = 0;        // Unconsumed bits, left-aligned (next bit is the MSB)
+    int bitCount = 0;              // How many bits of bitBuffer are valid
 
-    // Buffer for bulk reading
-    std::vector<char> fileBuffer;
-    size_t bufferIndex = 0;
-    size_t bufferSize = 0;
+    // Buffer for bulk reading (stream mode only); [cursor, end) has not been loaded
+    // into bitBuffer yet and points into fileBuffer or the caller's memory
+    std::vector<unsigned char> fileBuffer;
+    const unsigned char* cursor = nullptr;
+    const unsigned char* end = nullptr;
 
+    // refill() near the end of the buffered input
+    void refillSlow();
     bool refillBuffer();
 };
 
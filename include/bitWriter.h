@@ -3,42 +3,73 @@
 
 #include <ostream>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 // Forward declaration to avoid circular dependency with huffmanTree.h
 class HuffmanNode;
 
 /*
  * BitWriter is a utility class that allows writing individual bits
- * (not just full bytes) to an output stream efficiently.
- * It buffers bits and flushes them as bytes, used during compression.
+ * (not just full bytes) to an output stream or a memory buffer efficiently.
+ * Bits collect in a 64-bit accumulator that is emitted 32 bits at a time into
+ * a byte buffer, which is written to the stream in large chunks.
  */
 class BitWriter {
 public:
     // Constructor: binds the writer to an output stream
     explicit BitWriter(std::ostream& outputStream);
 
+    // Constructor: appends everything written to `memory` instead of a stream
+    explicit BitWriter(std::vector<unsigned char>& memory);
+
     // Destructor: flushes any remaining bits in buffer
     ~BitWriter();
 
     // Writes a single bit (true for 1, false for 0)
     void writeBit(bool bit);
 
-    // Writes a full byte (8 bits) bit-by-bit into the stream
+    // Writes a full byte (8 bits) into the stream
     void writeByte(unsigned char byte);
 
     // Writes a sequence of bits represented as a string of '0' and '1'
     void writeBits(const std::string& bits);
 
+    // Writes the low `length` bits of `code` (length <= 32), most significant first.
+    // Defined inline: the encoder calls it once per input byte.
+    void writeBits(uint32_t code, int length) {
+        bitBuffer = (bitBuffer << length) | code;
+        bitCount += length;
+        if (bitCount >= 32) {
+            bitCount -= 32;
+            uint32_t word = static_cast<uint32_t>(bitBuffer >> bitCount);
+            unsigned char* dest = byteBuffer.data() + byteCount;
+            dest[0] = static_cast<unsigned char>(word >> 24);
+            dest[1] = static_cast<unsigned char>(word >> 16);
+            dest[2] = static_cast<unsigned char>(word >> 8);
+            dest[3] = static_cast<unsigned char>(word);
+            byteCount += 4;
+            if (byteCount + 4 > byteBuffer.size()) drainBuffer();
+        }
+    }
+
     // Writes the serialized Huffman tree (pre-order format)
     void writeTree(HuffmanNode* root);
 
-    // Flushes remaining bits (pads with 0s to complete a byte)
+    // Flushes remaining bits (pads with 0s to complete a byte) and writes
+    // everything buffered so far to the stream
     void flush();
 
 private:
-    std::ostream& out;         // Output stream reference
-    unsigned char buffer = 0;  // Bit buffer (8-bit accumulator)
-    int bitCount = 0;          // Number of bits currently in buffer
+    std::ostream* out = nullptr;           // Output stream, or nullptr when writing to memory
+    std::vector<unsigned char>* sink = nullptr; // Memory output
+    uint64_t bitBuffer = 0;                // Bit accumulator; the low bitCount bits are pending
+    int bitCount = 0;                      // Number of pending bits (always < 32 between calls)
+    std::vector<unsigned char> byteBuffer; // Completed bytes waiting to be written
+    size_t byteCount = 0;
+
+    // Writes the completed bytes to the stream or memory
+    void drainBuffer();
 
     // Recursively serializes the Huffman tree
     void serializeTree(HuffmanNode* node);
@@ -0,0 +1,119 @@
+#ifndef BLOCKCODEC_H
+#define BLOCKCODEC_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <istream>
+#include "bitReader.h"
+#include "canonicalCode.h"
+#include "decodeTable.h"
+
+// Fields that precede every block body in a version 3 stream
+struct BlockHeader {
+    uint8_t flags = 0;
+    uint64_t rawSize = 0;   // Bytes the block decodes to
+    uint64_t bodySize = 0;  // Bytes of code lengths + bitstream that follow
+};
+
+// Where one block sits in a version 3 stream, as recorded by the block index
+struct BlockIndexEntry {
+    uint8_t flags = 0;
+    uint64_t rawSize = 0;    // Bytes the block decodes to
+    uint64_t storedSize = 0; // Bytes of header and body in the stream
+};
+
+// What the code length cap cost while encoding a block
+struct BlockStats {
+    uint64_t payloadBits = 0;    // Bitstream size with the capped lengths
+    uint64_t unlimitedBits = 0;  // Bitstream size had the lengths been uncapped
+    int longestCode = 0;
+    int longestUnlimited = 0;
+    bool reusedTable = false;
+};
+
+/*
+ * BlockCodec encodes and decodes the self-contained blocks of a version 3
+ * stream. Each block carries its own canonical code, so the input only has to
+ * be read once and the code follows the data as it changes along the file.
+ */
+class BlockCodec {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1 << 20;  // 1MB
+    static constexpr size_t MAX_BLOCK_SIZE = 64 << 20;     // Largest block a reader accepts
+
+    // Longest run of blocks sharing one table. Each run is decoded by a single
+    // thread, so this keeps work for parallel decoders in files with reused tables.
+    static constexpr int MAX_SHARED_TABLE_BLOCKS = 8;
+
+    // Smallest block worth splitting into interleaved streams
+    static constexpr size_t MIN_INTERLEAVED_SIZE = 16 * 1024;
+
+    // Most bytes a stored block takes beyond its raw size: header fields, a code
+    // length table (under 720 bytes) and interleaving sizes and padding. The bit
+    // stream itself never exceeds 8 bits per byte, as Huffman codes are no longer
+    // than a fixed-length code, and a reused table is only chosen when it is smaller.
+    static constexpr size_t MAX_BLOCK_OVERHEAD = 1024;
+
+    // Most bytes the end marker, index and trailer take: a fixed part plus a
+    // per-block entry
+    static constexpr size_t MAX_INDEX_OVERHEAD = 1 + 10 + 12;
+    static constexpr size_t MAX_INDEX_ENTRY_SIZE = 1 + 10 + 10;
+
+    // Appends one complete block (header and body) encoding `size` bytes of `data`.
+    // With `interleaved`, blocks of at least MIN_INTERLEAVED_SIZE are written as
+    // DecodeTable::INTERLEAVED_STREAMS streams that decode side by side. If
+    // `previous` holds the lengths of the block written just before, the block
+    // reuses them when that is smaller than storing a fresh table; either way
+    // `previous` receives the lengths this block was coded with. An all-zero
+    // `previous` means there is no earlier table. If `stats` is given, it also
+    // measures the cost of the code length cap.
+    static void encodeBlock(const unsigned char* data, size_t size, int maxCodeLength, bool interleaved,
+                            std::vector<unsigned char>& out, CodeLengths* previous = nullptr,
+                            BlockStats* stats = nullptr);
+
+    // Appends one block coded with the given `lengths`, which must be valid and
+    // give a code to every byte in `data`. With `storeTable` the lengths are
+    // written into the block; otherwise it is flagged to reuse the table of
+    // the block before it, which the caller guarantees is the same.
+    static void encodeBlockWith(const unsigned char* data, size_t size, const CodeLengths& lengths,
+                                bool storeTable, bool interleaved, std::vector<unsigned char>& out);
+
+    // Appends the marker that ends the block sequence
+    static void writeEndMarker(std::vector<unsigned char>& out);
+
+    // Appends the block index and the fixed-size trailer that locates it.
+    // `indexOffset` is the stream position the index will be written at.
+    static void writeIndex(const std::vector<BlockIndexEntry>& index, uint64_t indexOffset,
+                           std::vector<unsigned char>& out);
+
+    // Loads the block index through the trailer at the end of a seekable stream.
+    // Returns false if there is none or it does not add up to the stream's layout.
+    static bool readIndex(std::istream& input, std::vector<BlockIndexEntry>& index);
+
+    // Reads the fields in front of a block body and checks them for sanity
+    static bool readHeader(BitReader& reader, BlockHeader& header);
+
+    // Reads the block `entry` describes from the current position of `input` into
+    // `stored` and parses its header; `body` is left pointing into `stored`.
+    // Returns false if the stream ends early or the header disagrees with the index.
+    static bool readIndexedBlock(std::istream& input, const BlockIndexEntry& entry,
+                                 std::vector<unsigned char>& stored, BlockHeader& header,
+                                 const unsigned char*& body);
+
+    // Same for a block already in memory: `stored` holds its entry.storedSize bytes
+    static bool readIndexedBlock(const unsigned char* stored, const BlockIndexEntry& entry,
+                                 BlockHeader& header, const unsigned char*& body);
+
+    // Builds `table` from the code lengths at the start of a block body without
+    // decoding the block itself. The block must carry its own table.
+    static bool loadTable(const BlockHeader& header, const unsigned char* body,
+                          DecodeTable& table, bool multiSymbol = true);
+
+    // Decodes a block body into `output` (header.rawSize bytes). `table` is rebuilt
+    // from the body, or used as it is for blocks that reuse the previous table.
+    static bool decodeBody(const BlockHeader& header, const unsigned char* body,
+                           unsigned char* output, DecodeTable& table, bool multiSymbol = true);
+};
+
+#endif // BLOCKCODEC_H
@@ -0,0 +1,82 @@
+#ifndef BYTEPIPE_H
+#define BYTEPIPE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+/*
+ * BytePipe carries a byte stream from one thread to another in memory, so a
+ * stream-based producer (such as a decoder writing to a std::ostream) can feed
+ * a stream-based consumer directly instead of through a temporary file.
+ *
+ * The writer fills chunks through output() and the reader drains them through
+ * input(). At most `maxChunks` full chunks wait in between: a writer that gets
+ * ahead blocks until the reader catches up, so memory stays bounded however
+ * long the stream is. Either side can hang up: closeWrite() ends the stream
+ * for the reader once it has drained it, and closeRead() makes all further
+ * writes fail, so a producer stops when its data is no longer wanted.
+ */
+class BytePipe {
+public:
+    explicit BytePipe(size_t chunkSize = 1024 * 1024, size_t maxChunks = 4);
+
+    BytePipe(const BytePipe&) = delete;
+    BytePipe& operator=(const BytePipe&) = delete;
+
+    // For a std::ostream on the writing thread and a std::istream on the reading one
+    std::streambuf* output() { return &writer; }
+    std::streambuf* input() { return &reader; }
+
+    // Writer: passes on what is buffered and marks the end of the stream
+    void closeWrite();
+
+    // Reader: drops what is buffered and fails every later write
+    void closeRead();
+
+private:
+    class Writer : public std::streambuf {
+    public:
+        explicit Writer(BytePipe& pipe) : pipe(pipe) {}
+        bool flushChunk();
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    private:
+        BytePipe& pipe;
+        std::vector<char> chunk;
+    };
+
+    class Reader : public std::streambuf {
+    public:
+        explicit Reader(BytePipe& pipe) : pipe(pipe) {}
+
+    protected:
+        int_type underflow() override;
+
+    private:
+        BytePipe& pipe;
+        std::vector<char> chunk;
+    };
+
+    bool push(std::vector<char>& chunk);
+    bool pop(std::vector<char>& chunk);
+
+    const size_t chunkSize;
+    const size_t maxChunks;
+    Writer writer{*this};
+    Reader reader{*this};
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::vector<char>> chunks;
+    bool writeClosed = false;
+    bool readClosed = false;
+};
+
+#endif // BYTEPIPE_H
@@ -0,0 +1,54 @@
+#ifndef CANONICALCODE_H
+#define CANONICALCODE_H
+
+#include <array>
+#include <cstdint>
+#include "bitReader.h"
+#include "bitWriter.h"
+#include "codeTable.h"
+#include "histogram.h"
+
+// Code length of every byte value; 0 means the byte does not occur
+using CodeLengths = std::array<uint8_t, 256>;
+
+// Canonical code bits of every byte value, right-aligned
+using CodeBits = std::array<uint32_t, 256>;
+
+/*
+ * CanonicalCode derives Huffman codes from code lengths alone.
+ *
+ * Codes are assigned in order of (length, byte value), so the encoder and the
+ * decoder only need to agree on the 256 lengths; no tree is stored or built.
+ */
+class CanonicalCode {
+public:
+    static constexpr int MAX_CODE_LENGTH = 32;          // Longest code the format can store
+    static constexpr int DEFAULT_MAX_CODE_LENGTH = 15;  // Keeps every code inside the decode tables
+
+    // Computes Huffman code lengths from byte frequencies without building a node tree.
+    // A lone symbol gets length 1 (it is still coded with no bits). No length exceeds `maxLength`, which is clamped to
+    // [bits needed for the symbol count, MAX_CODE_LENGTH]; 0 means MAX_CODE_LENGTH.
+    // When the cap binds, lengths come from package-merge and are optimal under it.
+    static CodeLengths buildLengths(const FrequencyTable& frequencies,
+                                    int maxLength = DEFAULT_MAX_CODE_LENGTH);
+
+    // Size of the encoded payload in bits; 0 when only one byte value has a code
+    static uint64_t encodedBits(const FrequencyTable& frequencies,
+                                const CodeLengths& lengths);
+
+    // Assigns canonical codes. Returns false if the lengths over-subscribe the code space.
+    static bool assignCodes(const CodeLengths& lengths, CodeBits& codes);
+
+    // Same, packaged as the encoder's per-byte table. A lone symbol gets the empty
+    // code (length 0), so a block of one repeated byte has no payload at all.
+    static bool buildCodeTable(const CodeLengths& lengths, CodeTable& table);
+
+    // Serializes the lengths as zero-run-separated ranges of fixed-width fields:
+    //   byte   : bits per length field
+    //   varint : number of ranges
+    //   per range: varint gap (absent bytes skipped), varint count, count length fields
+    static void writeLengths(BitWriter& writer, const CodeLengths& lengths);
+    static bool readLengths(BitReader& reader, CodeLengths& lengths);
+};
+
+#endif // CANONICALCODE_H
@@ -0,0 +1,16 @@
+#ifndef CODETABLE_H
+#define CODETABLE_H
+
+#include <array>
+#include <cstdint>
+
+// A Huffman code as an integer: the low `length` bits of `bits`, sent MSB first
+struct HuffmanCode {
+    uint32_t bits = 0;
+    uint8_t length = 0;  // 0 means the byte has no code, or is the only one a canonical code has
+};
+
+// Encoder table indexed directly by byte value
+using CodeTable = std::array<HuffmanCode, 256>;
+
+#endif // CODETABLE_H
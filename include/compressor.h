@@ -3,19 +3,50 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
 #include <cstdint>
+#include <cstddef>
+#include <span>
 #include "callbacks.h"
 #include "errors.h"
+#include "canonicalCode.h"
+#include "histogram.h"
+#include "blockCodec.h"
 
-// Forward declaration
+// Forward declarations
 class HuffmanNode;
+class BitWriter;
+class InputSource;
 
 class Compressor {
 public:
+    // Compresses the input in a single read into the block format (version 3):
+    // every block is counted, coded and written out as soon as it has been read
+    ErrorCode compress(const std::string& inputFilename, const std::string& outputFilename);
+
+    // Same for streams that need not be seekable or have a known length (pipes,
+    // std::cin/std::cout); memory use stays bounded by a few blocks
+    ErrorCode compress(std::istream& input, std::ostream& output);
+
+    // Compresses a buffer in memory into the same format, without touching the
+    // filesystem. `output` is replaced with the compressed data.
+    ErrorCode compressBuffer(std::span<const std::byte> input, std::vector<std::byte>& output);
+
+    // Same, into a caller's buffer; `written` receives the compressed size. Fails
+    // with BufferTooSmall unless `output` holds the result, which compressBound()
+    // always does.
+    ErrorCode compressBuffer(std::span<const std::byte> input, std::span<std::byte> output, size_t& written);
+
+    // Largest compressed size of `inputSize` bytes with the current block size
+    size_t compressBound(size_t inputSize) const;
+
     ErrorCode readFileAndBuildFrequency(const std::string& filename);
-    const std::unordered_map<unsigned char, int>& getFrequencyMap() const;
+    const FrequencyTable& getFrequencyMap() const;
     uint64_t getOriginalFileSize() const;
 
+    // Writes the legacy tree-based format (version 1)
     ErrorCode compressFile(const std::string& inputFilename,
                            const std::string& outputFilename,
                            const std::unordered_map<unsigned char, std::string>& codes,
@@ -23,10 +54,43 @@ public:
 
     void setLogger(LogCallback logCallback);
     void setProgressCallback(ProgressCallback progCallback);
+    void setMaxCodeLength(int length);
+    void setBlockSize(size_t size);
+
+    // Worker threads used by compress(); 0 (the default) means one per hardware thread.
+    // With one thread, blocks may reuse the previous block's table.
+    void setThreadCount(unsigned count);
+
+    // Splits each block into interleaved streams that decode faster on one core (default on)
+    void setInterleaved(bool enabled);
 
 private:
-    std::unordered_map<unsigned char, int> freqMap;
+    // compress() once the input is open
+    ErrorCode compressSource(InputSource& input, std::ostream& output);
+
+    // Block loops behind compress()
+    void compressBlocks(InputSource& input, std::ostream& output, uint64_t expectedSize);
+    void compressBlocksParallel(InputSource& input, std::ostream& output,
+                                unsigned threads, uint64_t expectedSize);
+    void recordBlock(const std::vector<unsigned char>& encoded, const BlockStats& stats,
+                     size_t size, uint64_t expectedSize);
+
+    // Encodes the whole input through a per-byte code table. Bytes without an
+    // integer code are looked up in `longCodes` (legacy codes over 32 bits).
+    ErrorCode encodeStream(InputSource& input, BitWriter& writer, const CodeTable& table,
+                           const std::unordered_map<unsigned char, std::string>* longCodes = nullptr);
+
+    FrequencyTable frequencies{};
     uint64_t originalFileSize = 0;
+    int maxCodeLength = CanonicalCode::DEFAULT_MAX_CODE_LENGTH;
+    size_t blockSize = BlockCodec::DEFAULT_BLOCK_SIZE;
+    unsigned threadCount = 0;
+    bool interleaved = true;
+
+    // Totals of the last compress() call
+    BlockStats totalStats;
+    std::vector<BlockIndexEntry> blockIndex;
+    uint64_t reusedTables = 0;
     LogCallback logger;
     ProgressCallback progress;
 };
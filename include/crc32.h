@@ -0,0 +1,15 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 as used by zip and gzip (reflected polynomial 0xEDB88320), computed
+// eight bytes at a time. Start with 0 and feed the data in any number of pieces.
+uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t size);
+
+// CRC of the concatenation of two pieces, from the CRC of each and the size of
+// the second, so pieces can be checksummed on different threads
+uint32_t crc32Combine(uint32_t crcFirst, uint32_t crcSecond, uint64_t secondSize);
+
+#endif // CRC32_H
@@ -0,0 +1,102 @@
+#ifndef DECODETABLE_H
+#define DECODETABLE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "bitReader.h"
+#include "canonicalCode.h"
+
+// Forward declaration to avoid pulling in the whole tree header
+struct HuffmanNode;
+
+/*
+ * DecodeTable resolves Huffman codes with flat table lookups instead of
+ * following one tree pointer per input bit.
+ *
+ * The root table is indexed by the next ROOT_BITS bits of the stream and
+ * resolves every code of that length or shorter in a single lookup. Longer
+ * codes land on a small second-level table indexed by the bits that follow.
+ * The rare codes that do not fit in either level are decoded bit by bit,
+ * either by walking the tree the table was built from or, for canonical
+ * codes, by counting codes per length.
+ *
+ * Optionally a multi-symbol table is built on top of the root table: each of
+ * its entries holds every complete code (up to MAX_MULTI_SYMBOLS) that fits
+ * in the peeked bits, so one lookup can emit several bytes of short-coded text.
+ */
+class DecodeTable {
+public:
+    static constexpr int ROOT_BITS = 11;    // Bits resolved by the first lookup
+    static constexpr int MAX_SUB_BITS = 7;  // Widest second-level table
+    static constexpr int MAX_MULTI_SYMBOLS = 4;
+    static constexpr int INTERLEAVED_STREAMS = 4;
+
+    // Builds the lookup tables from a deserialized Huffman tree.
+    // The tree must outlive the table (it backs the slow path for very long codes).
+    bool build(const HuffmanNode* root, bool multiSymbol = false);
+
+    // Builds the lookup tables straight from canonical code lengths.
+    // Returns false if the lengths do not describe a valid prefix code. A lone
+    // symbol is read with no bits, as CanonicalCode::buildCodeTable writes it.
+    bool build(const CodeLengths& lengths, bool multiSymbol = false);
+
+    // Decodes up to `count` symbols into `output`, one symbol per lookup.
+    // Returns how many symbols were decoded; fewer than `count` means the stream ran out.
+    size_t decode(BitReader& reader, unsigned char* output, size_t count) const;
+
+    // Same contract as decode(), but emits several symbols per lookup where possible.
+    // Requires the table to have been built with multiSymbol = true.
+    size_t decodeMulti(BitReader& reader, unsigned char* output, size_t count) const;
+
+    // Decodes INTERLEAVED_STREAMS independent bitstreams in one loop: stream i is
+    // sizes[i] bytes at streams[i] and fills counts[i] symbols of outputs[i]. Every
+    // stream advances in turn, so the CPU overlaps four decode chains instead of
+    // waiting on one; from memory this is about twice the speed of decodeMulti().
+    // Uses the multi-symbol table when it was built.
+    // Returns false if a stream runs out or holds an invalid code.
+    bool decodeInterleaved(const unsigned char* const* streams, const size_t* sizes,
+                           unsigned char* const* outputs, const size_t* counts) const;
+
+private:
+    enum class EntryKind : uint8_t {
+        Leaf,   // `value` is the symbol, `length` the full code length
+        Sub,    // `value` is the offset of a sub-table, `length` its width in bits
+        Long    // Code is longer than both levels cover; decode bit by bit
+    };
+
+    struct Entry {
+        uint16_t value = 0;
+        uint8_t length = 0;
+        EntryKind kind = EntryKind::Long;
+    };
+
+    struct MultiEntry {
+        unsigned char symbols[MAX_MULTI_SYMBOLS] = {};
+        uint8_t count = 0;    // Complete codes in this entry (0 if the first code is too long)
+        uint8_t length = 0;   // Total bits they consume
+    };
+
+    std::vector<Entry> entries;          // Root table followed by all sub-tables
+    std::vector<MultiEntry> multiEntries; // Indexed like the root table
+    const HuffmanNode* root = nullptr;   // Tree backing the slow path, if built from one
+    bool singleSymbol = false;           // Only one symbol has a code, and it is empty
+    unsigned char singleByte = 0;        // That symbol
+
+    // Canonical slow path: codes per length and bytes sorted by (length, value)
+    std::array<uint16_t, CanonicalCode::MAX_CODE_LENGTH + 1> lengthCount{};
+    std::vector<unsigned char> sortedSymbols;
+
+    void reset();
+    void fillRoot(const HuffmanNode* node, uint32_t code, int depth);
+    void fillSub(const HuffmanNode* node, size_t offset, int width, uint32_t code, int depth);
+    void buildMulti();
+    bool decodeOne(BitReader& reader, unsigned char& symbol) const;
+    bool decodeSlow(BitReader& reader, unsigned char& symbol) const;
+    template <bool Multi>
+    bool decodeInterleavedWith(const unsigned char* const* streams, const size_t* sizes,
+                               unsigned char* const* outputs, const size_t* counts) const;
+    bool decodeCanonicalSlow(BitReader& reader, unsigned char& symbol) const;
+};
+
+#endif // DECODETABLE_H
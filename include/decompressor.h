@@ -3,30 +3,90 @@
 
 #include "bitReader.h"
 #include "huffmanTree.h"
+#include "decodeTable.h"
+#include "blockCodec.h"
 #include "callbacks.h"
 #include "errors.h"
+#include "memoryStream.h"
 #include <string>
 #include <fstream>
 #include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Strategy used to turn the bitstream back into bytes
+enum class DecodeMode {
+    TreeWalk,      // Follow one tree pointer per bit (reference; version 1 files only)
+    SingleSymbol,  // One table lookup per symbol
+    MultiSymbol    // One table lookup emits up to four short-coded symbols
+};
 
 class Decompressor {
 public:
+    static constexpr uint64_t DEFAULT_MAX_OUTPUT_SIZE = uint64_t(1) << 30;  // 1GB
+
     ErrorCode decompressFile(const std::string& inputFilename, const std::string& outputFilename);
 
+    // Decodes a stream front to back (pipes, std::cin/std::cout). Block files are
+    // decoded block by block in bounded memory; their index is not needed.
+    ErrorCode decompress(std::istream& input, std::ostream& output);
+
+    // Decompresses a buffer in memory (any format version) without touching the
+    // filesystem. `output` is replaced with the original data. Data that would
+    // grow it past setMaxOutputSize() fails with DecompressionFailed before it is
+    // decoded, as a few forged header bytes can claim any size.
+    ErrorCode decompressBuffer(std::span<const std::byte> input, std::vector<std::byte>& output);
+
+    // Same, into a caller's buffer; `written` receives the original size. Fails
+    // with BufferTooSmall if `output` cannot hold it.
+    ErrorCode decompressBuffer(std::span<const std::byte> input, std::span<std::byte> output, size_t& written);
+
+    // Writes `length` bytes of the original data starting at `offset` (clamped to
+    // its end) to `outputFilename`. Uses the block index, so only the blocks that
+    // overlap the range are decoded. Files without an index are rejected.
+    ErrorCode decompressRange(const std::string& inputFilename, uint64_t offset, uint64_t length,
+                              const std::string& outputFilename);
+
+    // Size of the original data of an indexed file, read from its block index
+    ErrorCode readContentSize(const std::string& inputFilename, uint64_t& size);
+
     uint64_t getOriginalFileSize() const;
 
     void setLogger(LogCallback logCallback);
     void setProgressCallback(ProgressCallback progCallback);
+    void setDecodeMode(DecodeMode mode);
+
+    // Most bytes decompressBuffer() puts into a vector; 0 means no limit
+    void setMaxOutputSize(uint64_t bytes);
+
+    // Worker threads for indexed block files; 0 (the default) means one per hardware thread
+    void setThreadCount(unsigned count);
 
     ~Decompressor();  // Destructor to free tree memory
 
 private:
+    void resetState();
+    ErrorCode decodeStream(int version, BitReader& reader, std::ostream& output, uint64_t compressedSize,
+                           uint64_t outputLimit = 0);
+    ErrorCode decodeBuffer(std::span<const std::byte> input, MemoryOutputBuffer& buffer, uint64_t outputLimit);
+    ErrorCode readLegacyHeader(BitReader& reader, DecodeTable& table);
+    ErrorCode readCanonicalHeader(BitReader& reader, DecodeTable& table);
+    ErrorCode loadBlockIndex(const std::string& inputFilename, std::ifstream& input,
+                             std::vector<BlockIndexEntry>& index);
     HuffmanNode* deserializeTree(BitReader& reader);
-    void decode(BitReader& reader, std::ostream& output, HuffmanNode* root, uint64_t originalSize);
+    bool decode(BitReader& reader, std::ostream& output, const DecodeTable& table, uint64_t originalSize);
+    ErrorCode decodeBlocks(BitReader& reader, std::ostream& output, uint64_t compressedSize, uint64_t outputLimit);
+    ErrorCode decodeBlocksParallel(const std::string& inputFilename, const unsigned char* mapped,
+                                   const std::string& outputFilename,
+                                   const std::vector<BlockIndexEntry>& index, unsigned threads);
     void freeTree(HuffmanNode* node);
 
     HuffmanNode* root = nullptr;  // Store root for cleanup
     uint64_t originalFileSize = 0;
+    DecodeMode decodeMode = DecodeMode::MultiSymbol;
+    unsigned threadCount = 0;
+    uint64_t maxOutputSize = DEFAULT_MAX_OUTPUT_SIZE;
     LogCallback logger;
     ProgressCallback progress;
 };
@@ -15,6 +15,8 @@ enum class ErrorCode {
     TreeDeserializationError,
     CompressionFailed,
     DecompressionFailed,
+    BufferTooSmall,
+    ChecksumMismatch,
     UnknownError
 };
 
@@ -31,6 +33,8 @@ inline std::string getErrorMessage(ErrorCode code) {
         case ErrorCode::TreeDeserializationError: return "Failed to deserialize Huffman tree.";
         case ErrorCode::CompressionFailed: return "Compression process failed.";
         case ErrorCode::DecompressionFailed: return "Decompression process failed.";
+        case ErrorCode::BufferTooSmall: return "Output buffer is too small.";
+        case ErrorCode::ChecksumMismatch: return "Data does not match its checksum.";
         default: return "Unknown error occurred.";
     }
 }
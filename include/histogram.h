@@ -0,0 +1,35 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Occurrence count of every byte value
+using FrequencyTable = std::array<uint64_t, 256>;
+
+/*
+ * Histogram counts byte frequencies for the first compression pass.
+ *
+ * Consecutive bytes go to different count tables ("lanes") so that runs of the
+ * same byte do not stall on back-to-back increments of one counter. The lanes
+ * are summed when the result is requested. Counts are 64-bit, so a single
+ * symbol may occur more than 4 billion times.
+ */
+class Histogram {
+public:
+    static constexpr int LANES = 4;
+
+    // Adds every byte of the buffer to the counts
+    void add(const unsigned char* data, size_t size);
+
+    // Sums the lanes into one table
+    FrequencyTable merge() const;
+
+    void clear();
+
+private:
+    std::array<FrequencyTable, LANES> lanes{};
+};
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,61 @@
+#ifndef HPAFORMAT_H
+#define HPAFORMAT_H
+
+/*
+ * On-disk layout of native .hpa archives.
+ *
+ * Earlier archives are a HUFFARCH bundle (see Archiver::archiveDirectory)
+ * compressed as one .hpf stream. A native archive is compressed member by
+ * member instead, so every file gets its own code tables and members are
+ * coded in parallel:
+ *   HPA_MAGIC, version byte (1 to 3)
+ *   varint : number of members
+ *   per member:
+ *     varint : path length, then the relative path ('/'-separated, UTF-8)
+ *     varint : original size
+ *     byte   : member flags (HPA_MEMBER_*; version 2 on)
+ *     blocks : the member's data in the .hpf version 3 block layout, ended by
+ *              HPF_BLOCK_END (an empty file is the end marker alone)
+ * A member flagged HPA_MEMBER_DUPLICATE has the same contents as an earlier
+ * one: instead of blocks it stores a varint with the index of the first
+ * member holding those contents, which is never a duplicate itself.
+ * A member flagged HPA_MEMBER_SOLID belongs to a solid group of small files
+ * coded with one shared table: it is followed by a varint with the index of
+ * the group's first member, whose data is a single block carrying that
+ * table, and its own blocks all reuse it (HPF_BLOCK_REUSE_TABLE). The first
+ * member of a group has no flags and is neither a duplicate nor solid.
+ *
+ * Archives may continue after the last member with a central directory, so a
+ * reader can list the members and extract one without scanning the others:
+ *   varint : number of entries, one per member in archive order
+ *   per entry:
+ *     byte   : the member's flags
+ *     varint : path length, then the path
+ *     varint : original size
+ *     4 bytes: big-endian CRC-32 of the original data (see crc32.h)
+ *     varint : archive offset of the member, at its path length field
+ *     varint : stored size of the member (everything up to the next member)
+ *     varint : for HPA_MEMBER_DUPLICATE and HPA_MEMBER_SOLID only, the index
+ *              of the member referred to
+ *     8 bytes: big-endian modification time of the file, in nanoseconds since
+ *              the Unix epoch (version 3 on), so an update can tell which
+ *              files changed since the archive was written
+ *   trailer  : 8-byte big-endian offset of the directory, HPA_DIRECTORY_MAGIC
+ * Sequential readers stop after the last member and never see it.
+ */
+constexpr unsigned char HPA_MAGIC[4] = {0xFF, 'H', 'P', 'A'};
+constexpr int HPA_VERSION_FIRST = 1;
+constexpr int HPA_VERSION = 3;
+
+// Member flags (version 2 on)
+constexpr unsigned char HPA_MEMBER_DUPLICATE = 0x01;
+constexpr unsigned char HPA_MEMBER_SOLID = 0x02;
+
+// Central directory trailer
+constexpr unsigned char HPA_DIRECTORY_MAGIC[4] = {'H', 'P', 'A', 'D'};
+constexpr int HPA_TRAILER_SIZE = 12;
+
+// The HUFFARCH bundle inside earlier .hpa files
+constexpr char LEGACY_ARCHIVE_MAGIC[8] = {'H', 'U', 'F', 'F', 'A', 'R', 'C', 'H'};
+
+#endif // HPAFORMAT_H
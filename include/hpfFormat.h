@@ -0,0 +1,76 @@
+#ifndef HPFFORMAT_H
+#define HPFFORMAT_H
+
+#include <cstdint>
+#include <vector>
+#include "bitReader.h"
+#include "bitWriter.h"
+
+/*
+ * On-disk layout of .hpf files.
+ *
+ * Version 1 (legacy) has no header: a pre-order Huffman tree, the original
+ * size as 64-bit big-endian, then the encoded bitstream.
+ *
+ * Every later version starts with HPF_MAGIC followed by a version byte.
+ * The first magic byte is 0xFF, which a version 1 stream can only start with
+ * when its tree is a single leaf for byte 0xFE or 0xFF; readers therefore
+ * check the whole magic and the version byte before taking a stream for a
+ * later version.
+ *
+ * Version 2 (canonical):
+ *   magic, version, varint original size, code-length table, bitstream
+ * A code-length table with a single entry codes that byte with no bits, so
+ * input of one repeated byte value has an empty bitstream.
+ *
+ * Version 3 (blocks): magic, version, then a sequence of blocks that each
+ * carry their own code and are written as soon as they are encoded:
+ *   byte   : flags (HPF_BLOCK_*; HPF_BLOCK_END alone marks the end of the stream)
+ *   varint : decoded size of the block
+ *   varint : body size in bytes
+ *   body   : code-length table and bitstream, padded to a whole byte
+ * A block flagged HPF_BLOCK_REUSE_TABLE has no code-length table and is coded
+ * with the table of the block before it. A block flagged HPF_BLOCK_INTERLEAVED
+ * splits its input into four consecutive quarters (the last one may be
+ * shorter) coded as separate bitstreams; after the table its body is padded
+ * to a byte and holds three varint sizes of the first three streams, then the
+ * four streams, each padded to a whole byte. The end marker is a lone flags
+ * byte, so an empty input is a valid stream.
+ *
+ * Files may continue after the end marker with a block index, so a reader
+ * can locate every block without scanning the ones before it:
+ *   varint : number of blocks
+ *   per block: byte flags, varint decoded size, varint stored size (header + body)
+ *   trailer  : 8-byte big-endian offset of the index, HPF_INDEX_MAGIC
+ * Sequential readers stop at the end marker and never see it.
+ */
+constexpr unsigned char HPF_MAGIC[4] = {0xFF, 'H', 'P', 'F'};
+
+constexpr int HPF_VERSION_LEGACY = 1;
+constexpr int HPF_VERSION_CANONICAL = 2;
+constexpr int HPF_VERSION_BLOCKS = 3;
+
+// Block flags (version 3)
+constexpr unsigned char HPF_BLOCK_REUSE_TABLE = 0x01;
+constexpr unsigned char HPF_BLOCK_INTERLEAVED = 0x02;
+constexpr unsigned char HPF_BLOCK_END = 0x80;
+
+// Block index trailer (version 3)
+constexpr unsigned char HPF_INDEX_MAGIC[4] = {'H', 'P', 'F', 'I'};
+constexpr int HPF_TRAILER_SIZE = 12;
+
+// Writes the magic bytes and the version byte
+void writeFormatHeader(BitWriter& writer, int version);
+
+// Identifies the format without consuming anything from a version 1 stream.
+// Returns the stored version byte when the stream starts with HPF_MAGIC and a
+// known later version, and HPF_VERSION_LEGACY for anything else, which is then
+// read from its first byte.
+int readFormatVersion(BitReader& reader);
+
+// Unsigned LEB128: 7 bits per byte, least significant group first
+void writeVarint(BitWriter& writer, uint64_t value);
+void writeVarint(std::vector<unsigned char>& out, uint64_t value);
+bool readVarint(BitReader& reader, uint64_t& value);
+
+#endif // HPFFORMAT_H
@@ -4,15 +4,17 @@
 #include <unordered_map>
 #include <queue>
 #include <string>
+#include <cstdint>
+#include "histogram.h"
 
 struct HuffmanNode {
     unsigned char byte;
-    int frequency;
+    uint64_t frequency;
     HuffmanNode* left;
     HuffmanNode* right;
 
-    HuffmanNode(unsigned char b, int freq);
-    HuffmanNode(int freq, HuffmanNode* l, HuffmanNode* r);
+    HuffmanNode(unsigned char b, uint64_t freq);
+    HuffmanNode(uint64_t freq, HuffmanNode* l, HuffmanNode* r);
     ~HuffmanNode() = default;  // Explicit default destructor
 
     bool isLeaf() const;
@@ -22,7 +24,7 @@ class HuffmanTree {
 public:
     HuffmanTree() = default;  // <-- Added default constructor
 
-    void build(const std::unordered_map<unsigned char, int>& freqMap);
+    void build(const FrequencyTable& frequencies);
     const std::unordered_map<unsigned char, std::string>& getHuffmanCodes() const;
     HuffmanNode* getRoot() const;
     void generateCodes();
@@ -0,0 +1,79 @@
+#ifndef INPUTSOURCE_H
+#define INPUTSOURCE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "errors.h"
+
+/*
+ * InputSource gives read-only access to an input file.
+ *
+ * Regular files are memory-mapped, so their bytes are used in place instead of
+ * being copied through stream buffers, and the kernel is told how the mapping
+ * will be read. Anything that cannot be mapped (pipes, devices, empty files,
+ * or a failed mapping) is read through a buffered stream instead.
+ */
+class InputSource {
+public:
+    enum class Access {
+        Sequential,  // Read once from front to back: aggressive read-ahead
+        Random       // Read in ranges: prefetch without dropping read pages
+    };
+
+    InputSource() = default;
+    ~InputSource();
+
+    InputSource(const InputSource&) = delete;
+    InputSource& operator=(const InputSource&) = delete;
+
+    ErrorCode open(const std::string& filename, Access access = Access::Sequential);
+
+    // Reads an already open stream (such as std::cin), which must outlive the source
+    void attach(std::istream& input);
+
+    // Reads a caller's buffer in place, as if it were a mapped file. The buffer
+    // must outlive the source.
+    void attach(const unsigned char* data, size_t size);
+
+    void close();
+
+    bool isMapped() const { return mapped != nullptr; }
+
+    // The whole input, while mapped
+    const unsigned char* data() const { return mapped; }
+
+    // Size of the input, if it is known (mapped, or a regular file)
+    bool hasSize() const { return sizeKnown; }
+    uint64_t size() const { return fileSize; }
+
+    // Returns the next `maxBytes` bytes of the input in `chunk`, fewer only at
+    // its end (0 once it is exhausted). A mapped chunk stays valid while the
+    // source is open; a buffered one only until the next call.
+    size_t next(const unsigned char*& chunk, size_t maxBytes);
+
+    // The stream behind an unmapped source
+    std::istream& stream() { return *input; }
+
+private:
+    const unsigned char* mapped = nullptr;
+    bool ownsMapping = false;     // False for an attached buffer
+    uint64_t fileSize = 0;
+    bool sizeKnown = false;
+    uint64_t position = 0;        // Bytes handed out by next()
+
+    std::ifstream file;           // Fallback when the file cannot be mapped
+    std::istream* input = &file;  // file, or an attached stream
+    std::vector<unsigned char> buffer;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+    bool map(const std::string& filename, Access access);
+};
+
+#endif // INPUTSOURCE_H
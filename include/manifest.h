@@ -0,0 +1,49 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "errors.h"
+
+// One regular file found under the scanned directory
+struct ManifestEntry {
+    uint64_t nameOffset = 0;  // Where the name starts in the manifest's name pool
+    uint32_t nameLength = 0;
+    uint64_t size = 0;
+    int64_t modified = 0;     // Last write time, nanoseconds since the Unix epoch
+};
+
+/*
+ * Manifest lists the regular files under a directory with their sizes and
+ * modification times, collected in a single pass by a parallel tree walk:
+ * every thread lists one directory at a time and hands the subdirectories it
+ * finds to the others. Names are relative to the directory, '/'-separated and
+ * kept in one string pool, so millions of entries stay compact; entries are
+ * sorted by name, so the same tree always gives the same manifest.
+ */
+class Manifest {
+public:
+    // Walks `directory` on `threads` threads (0 means one per hardware thread).
+    // Symbolic links to files are listed; those to directories are not followed.
+    // Directories that cannot be read make it fail with FileReadError, but the
+    // files that were found are still listed.
+    ErrorCode scan(const std::string& directory, unsigned threads = 0);
+
+    const std::vector<ManifestEntry>& entries() const;
+    std::string_view name(const ManifestEntry& entry) const;
+    std::filesystem::path path(const ManifestEntry& entry) const;  // Scanned directory / name
+
+    // Sum of all file sizes
+    uint64_t totalSize() const;
+
+private:
+    std::filesystem::path root;
+    std::vector<ManifestEntry> files;
+    std::string names;
+    uint64_t total = 0;
+};
+
+#endif // MANIFEST_H
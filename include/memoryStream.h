@@ -0,0 +1,34 @@
+#ifndef MEMORYSTREAM_H
+#define MEMORYSTREAM_H
+
+#include <cstddef>
+#include <span>
+#include <streambuf>
+#include <vector>
+
+// std::streambuf that writes to memory, so the stream-based encoders can fill a
+// caller's buffer: a vector that grows as needed (appended to), or a fixed span
+// that fails the stream once it is full.
+class MemoryOutputBuffer : public std::streambuf {
+public:
+    explicit MemoryOutputBuffer(std::vector<std::byte>& output);
+    explicit MemoryOutputBuffer(std::span<std::byte> output);
+
+    // Bytes written so far
+    size_t size() const { return written; }
+
+    // True once a write did not fit into the fixed span
+    bool overflowed() const { return full; }
+
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize count) override;
+    int_type overflow(int_type ch) override;
+
+private:
+    std::vector<std::byte>* vector = nullptr;
+    std::span<std::byte> fixed;
+    size_t written = 0;
+    bool full = false;
+};
+
+#endif // MEMORYSTREAM_H
@@ -0,0 +1,98 @@
+#ifndef STREAMCODEC_H
+#define STREAMCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "blockCodec.h"
+#include "canonicalCode.h"
+#include "decodeTable.h"
+#include "errors.h"
+
+/*
+ * CompressStream and DecompressStream produce and consume the block format
+ * (version 3) incrementally, for callers that get their data in fragments
+ * (event loops, network servers). They are driven with caller buffers, in the
+ * style of zlib's z_stream: every call takes what input it can, writes what
+ * output is ready and returns, so nothing ever blocks or waits for more data.
+ * At most one block of input and one block of output are held in between.
+ */
+class CompressStream {
+public:
+    // Settings take effect from the next block; the block size must be set
+    // before the first update()
+    void setMaxCodeLength(int length);
+    void setBlockSize(size_t size);
+    void setInterleaved(bool enabled);
+
+    // Takes input into the current block and fills `output` with compressed
+    // bytes as they become ready. `consumed` and `produced` receive how much of
+    // each buffer was used. Input stops being taken while coded output is
+    // waiting for room, so call again with fresh output space until all of
+    // `input` is consumed.
+    ErrorCode update(std::span<const std::byte> input, std::span<std::byte> output,
+                     size_t& consumed, size_t& produced);
+
+    // Ends the stream: codes the buffered input and appends the end marker and
+    // block index. Call with fresh output space until `done` is set.
+    ErrorCode finish(std::span<std::byte> output, size_t& produced, bool& done);
+
+    // Starts a new stream with the same settings
+    void reset();
+
+private:
+    size_t drain(std::span<std::byte> output);
+    void encode(const unsigned char* data, size_t size);
+
+    int maxCodeLength = CanonicalCode::DEFAULT_MAX_CODE_LENGTH;
+    size_t blockSize = BlockCodec::DEFAULT_BLOCK_SIZE;
+    bool interleaved = true;
+
+    bool started = false;
+    bool finishing = false;
+    std::vector<unsigned char> block;    // Input of the block being filled
+    std::vector<unsigned char> pending;  // Coded bytes not yet handed out
+    size_t pendingOffset = 0;
+
+    CodeLengths previousLengths{};
+    int sharedTableBlocks = 0;
+    std::vector<BlockIndexEntry> index;
+    uint64_t streamSize = 0;             // Bytes coded so far, for the index offset
+};
+
+class DecompressStream {
+public:
+    // Takes compressed input and fills `output` with decoded bytes as blocks
+    // complete. `consumed` and `produced` receive how much of each buffer was
+    // used. Call again with the unconsumed input and fresh output space; bytes
+    // after the end marker (the block index) are consumed and ignored.
+    ErrorCode update(std::span<const std::byte> input, std::span<std::byte> output,
+                     size_t& consumed, size_t& produced);
+
+    // True once the end marker was read and every decoded byte handed out.
+    // A stream that runs out of input before that is truncated.
+    bool finished() const;
+
+    // Starts a new stream
+    void reset();
+
+private:
+    enum class State { Magic, BlockHeader, Body, Done };
+
+    size_t drain(std::span<std::byte> output);
+    ErrorCode parseHeader();
+    ErrorCode decodeBlock(const unsigned char* body, std::span<std::byte> output, size_t& produced);
+
+    State state = State::Magic;
+    ErrorCode error = ErrorCode::Success;  // Sticky: a corrupted stream stays failed
+    std::vector<unsigned char> staging;    // Magic, a block header or a body split across calls
+    BlockHeader header;
+
+    DecodeTable table;
+    bool haveTable = false;
+    std::vector<unsigned char> block;      // Decoded bytes that did not fit the caller's output
+    size_t blockOffset = 0;
+};
+
+#endif // STREAMCODEC_H
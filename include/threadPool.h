@@ -0,0 +1,45 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * ThreadPool runs submitted tasks on a fixed set of worker threads.
+ * Tasks are started in submission order; each returns a future that
+ * becomes ready when it finishes (and rethrows anything it threw).
+ */
+class ThreadPool {
+public:
+    // Starts `threadCount` workers; 0 means one per hardware thread
+    explicit ThreadPool(unsigned threadCount = 0);
+
+    // Finishes the queued tasks, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    std::future<void> submit(std::function<void()> task);
+
+    unsigned size() const;
+
+    // Number of hardware threads, at least 1
+    static unsigned hardwareThreads();
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    void run();
+};
+
+#endif // THREADPOOL_H
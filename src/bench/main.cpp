@@ -0,0 +1,217 @@
+#include "compressor.h"
+#include "decompressor.h"
+#include "huffmanTree.h"
+#include "errors.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <iterator>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLE_COUNTER 1
+#else
+#define HAVE_CYCLE_COUNTER 0
+#endif
+
+namespace fs = std::filesystem;
+
+// Decode benchmark: compares the tree walk against the single- and multi-symbol
+// table decoders on text of the kinds listed in the README, then the block
+// format with one bitstream per block against four interleaved ones (one thread).
+// Every decoder reads the compressed data from memory and writes into memory,
+// so the numbers are decode throughput alone, without file I/O.
+//
+// Usage: HuffPressorBench [file...]
+// Without arguments, synthetic JSON, CSV, log, source and prose samples are generated.
+// Cycles come from the time-stamp counter (reference cycles, not core cycles).
+
+static const size_t SAMPLE_SIZE = 8 * 1024 * 1024; // 8MB per generated sample
+static const int REPEATS = 5;
+
+static uint64_t readCycles() {
+#if HAVE_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static std::string generateSample(const std::string& kind, size_t size) {
+    static const char* words[] = {
+        "request", "response", "user", "status", "timeout", "connection", "retry", "cache",
+        "value", "index", "buffer", "stream", "config", "result", "error", "data"
+    };
+    std::mt19937 rng(42);
+    auto word = [&]() { return std::string(words[rng() % 16]); };
+    auto number = [&](int max) { return std::to_string(rng() % max); };
+
+    std::string out;
+    out.reserve(size + 256);
+    while (out.size() < size) {
+        if (kind == "json") {
+            out += "  {\n    \"id\": " + number(100000) + ",\n    \"name\": \"" + word() +
+                   "\",\n    \"active\": " + (rng() % 2 ? "true" : "false") +
+                   ",\n    \"tags\": [\"" + word() + "\", \"" + word() + "\"]\n  },\n";
+        } else if (kind == "csv") {
+            out += number(1000000) + "," + word() + "," + number(1000) + "." + number(100) + "," + word() + "\n";
+        } else if (kind == "log") {
+            static const char* levels[] = {"INFO", "WARN", "ERROR", "DEBUG"};
+            out += "2025-01-" + number(28) + " 12:" + number(60) + ":" + number(60) + " [" +
+                   levels[rng() % 4] + "] " + word() + " " + word() + " " + word() + " id=" + number(99999) + "\n";
+        } else if (kind == "cpp") {
+            out += "    if (" + word() + " == nullptr) {\n        return " + word() + "(" + word() +
+                   ", " + number(64) + ");\n    }\n";
+        } else {
+            for (int i = 0; i < 12; ++i) out += word() + (i == 11 ? ".\n" : " ");
+        }
+    }
+    out.resize(size);
+    return out;
+}
+
+struct Measurement {
+    double seconds = 0;
+    uint64_t cycles = 0;
+};
+
+static Measurement timeDecode(Decompressor& decompressor, const std::vector<std::byte>& input,
+                              std::vector<std::byte>& output) {
+    Measurement best;
+    for (int i = 0; i < REPEATS; ++i) {
+        // Left over bytes of an earlier run must not pass for decoded ones
+        std::fill(output.begin(), output.end(), std::byte{0});
+        size_t written = 0;
+        auto start = std::chrono::steady_clock::now();
+        uint64_t startCycles = readCycles();
+
+        ErrorCode result = decompressor.decompressBuffer(input, output, written);
+
+        uint64_t cycles = readCycles() - startCycles;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (result == ErrorCode::Success && written != output.size()) result = ErrorCode::DecompressionFailed;
+        if (result != ErrorCode::Success) {
+            std::cerr << "Error: " << getErrorMessage(result) << "\n";
+            return {};
+        }
+        if (i == 0 || seconds < best.seconds) best = {seconds, cycles};
+    }
+    return best;
+}
+
+static std::vector<std::byte> readWholeFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::byte* data = reinterpret_cast<const std::byte*>(bytes.data());
+    return std::vector<std::byte>(data, data + bytes.size());
+}
+
+static void printRow(const char* name, uint64_t size, const Measurement& m, double baseline) {
+    std::cout << "  " << std::left << std::setw(22) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(8) << size / m.seconds / (1024 * 1024) << " MB/s";
+    if (HAVE_CYCLE_COUNTER && m.cycles > 0) {
+        std::cout << std::setprecision(3) << std::setw(8) << static_cast<double>(size) / m.cycles << " bytes/cycle";
+    }
+    std::cout << std::setprecision(2) << std::setw(8) << baseline / m.seconds << "x\n";
+    std::cout.unsetf(std::ios::fixed);
+}
+
+static bool benchmarkFile(const std::string& label, const std::string& path, const fs::path& workDir) {
+    std::string compressed = (workDir / "bench.hpf").string();
+
+    Compressor compressor;
+    HuffmanTree tree;
+    ErrorCode result = compressor.readFileAndBuildFrequency(path);
+    if (result != ErrorCode::Success) {
+        std::cerr << label << ": " << getErrorMessage(result) << "\n";
+        return false;
+    }
+    tree.build(compressor.getFrequencyMap());
+    result = compressor.compressFile(path, compressed, tree.getHuffmanCodes(), tree.getRoot());
+    if (result != ErrorCode::Success) {
+        std::cerr << label << ": " << getErrorMessage(result) << "\n";
+        return false;
+    }
+
+    const std::vector<std::byte> original = readWholeFile(path);
+    const std::vector<std::byte> packed = readWholeFile(compressed);
+    std::vector<std::byte> restored(original.size());
+
+    uint64_t size = original.size();
+    std::cout << label << " (" << size << " bytes, "
+              << std::setprecision(3) << 100.0 * packed.size() / size << "% of original)\n";
+
+    const std::pair<DecodeMode, const char*> modes[] = {
+        {DecodeMode::TreeWalk, "tree walk"},
+        {DecodeMode::SingleSymbol, "single-symbol table"},
+        {DecodeMode::MultiSymbol, "multi-symbol table"},
+    };
+
+    double baseline = 0;
+    for (const auto& [mode, name] : modes) {
+        Decompressor decompressor;
+        decompressor.setDecodeMode(mode);
+        Measurement m = timeDecode(decompressor, packed, restored);
+        if (m.seconds <= 0) return false;
+        // A speedup only counts if the decoder gives back the input
+        if (restored != original) {
+            std::cerr << label << ": " << name << " decoded different bytes\n";
+            return false;
+        }
+        if (mode == DecodeMode::TreeWalk) baseline = m.seconds;
+        printRow(name, size, m, baseline);
+    }
+
+    for (bool interleaved : {false, true}) {
+        Compressor blockCompressor;
+        blockCompressor.setThreadCount(1);
+        blockCompressor.setInterleaved(interleaved);
+        std::vector<std::byte> blocks;
+        if (blockCompressor.compressBuffer(original, blocks) != ErrorCode::Success) return false;
+
+        Decompressor decompressor;
+        decompressor.setThreadCount(1);
+        const char* name = interleaved ? "blocks, 4 streams" : "blocks, 1 stream";
+        Measurement m = timeDecode(decompressor, blocks, restored);
+        if (m.seconds <= 0) return false;
+        if (restored != original) {
+            std::cerr << label << ": " << name << " decoded different bytes\n";
+            return false;
+        }
+        printRow(name, size, m, baseline);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    fs::path workDir = fs::temp_directory_path() / "huffpressor_bench";
+    fs::create_directories(workDir);
+
+    bool ok = true;
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            ok = benchmarkFile(fs::path(argv[i]).filename().string(), argv[i], workDir) && ok;
+        }
+    } else {
+        for (const std::string kind : {"json", "csv", "log", "cpp", "txt"}) {
+            fs::path samplePath = workDir / ("sample." + kind);
+            std::ofstream sample(samplePath, std::ios::binary);
+            sample << generateSample(kind, SAMPLE_SIZE);
+            sample.close();
+            ok = benchmarkFile("sample." + kind, samplePath.string(), workDir) && ok;
+        }
+    }
+
+    fs::remove_all(workDir);
+    return ok ? 0 : 1;
+}
@@ -1,6 +1,8 @@
 #include "compressor.h"
 #include "decompressor.h"
-#include "huffmanTree.h"
+#include "archiver.h"
+#include "hpaFormat.h"
+#include "canonicalCode.h"
 #include "utils.h"
 #include "config.h"
 #include "errors.h"
@@ -8,65 +10,163 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <cstdlib>
 #include <iomanip>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+// Messages and progress go to stderr while stdout carries data
+static std::ostream* console = &std::cout;
 
 // Simple console logger
 void consoleLogger(const std::string& msg) {
-    std::cout << msg;
+    *console << msg;
 }
 
 // Simple console progress bar
 void consoleProgress(float percentage) {
     int barWidth = 50;
-    std::cout << "[";
+    *console << "[";
     int pos = barWidth * percentage / 100.0;
     for (int i = 0; i < barWidth; ++i) {
-        if (i < pos) std::cout << "=";
-        else if (i == pos) std::cout << ">";
-        else std::cout << " ";
+        if (i < pos) *console << "=";
+        else if (i == pos) *console << ">";
+        else *console << " ";
     }
-    std::cout << "] " << std::fixed << std::setprecision(1) << percentage << " %\r";
-    std::cout.flush();
-    if (percentage >= 100.0f) std::cout << std::endl;
+    *console << "] " << std::fixed << std::setprecision(1) << percentage << " %\r";
+    console->flush();
+    if (percentage >= 100.0f) *console << std::endl;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  " << program << " -c [-L <max_code_bits>] [-T <threads>] <input_file> <compressed_file>\n"
+              << "  " << program << " -d [-T <threads>] [-O <offset>] [-N <length>] <compressed_file> <output_file>\n"
+              << "  " << program << " -a [-L <max_code_bits>] [-T <threads>] <directory> <archive.hpa>\n"
+              << "  " << program << " -u [-L <max_code_bits>] [-T <threads>] [-H] <directory> <archive.hpa>\n"
+              << "  " << program << " -x [-T <threads>] <archive.hpa> <directory>\n"
+              << "  " << program << " -l <archive.hpa>\n"
+              << "  " << program << " -e <archive.hpa> <member> <output_file>\n"
+              << "Options:\n"
+              << "  -L <bits>  Longest Huffman code allowed (default "
+              << CanonicalCode::DEFAULT_MAX_CODE_LENGTH << ", max " << CanonicalCode::MAX_CODE_LENGTH << ")\n"
+              << "  -T <n>     Worker threads (default 0 = one per CPU core)\n"
+              << "  -O <bytes> Extract from this offset of the original data; negative counts from the end\n"
+              << "  -N <bytes> Extract at most this many bytes (default: to the end)\n"
+              << "  -H         Update: also compare checksums of files whose size and time match\n"
+              << "A file name of - reads stdin or writes stdout.\n";
 }
 
 int main(int argc, char* argv[]) {
-    // Validate argument count; Expecting: program -mode input output
-    if (argc != 4) {
-        std::cerr << "Usage:\n"
-                  << "  " << argv[0] << " -c <input_file> <compressed_file>\n"
-                  << "  " << argv[0] << " -d <compressed_file> <output_file>\n";
+    // Expecting: program -mode [options] input output
+    if (argc < 3) {
+        printUsage(argv[0]);
         return 1;
     }
 
-    std::string mode       = argv[1];  // -c or -d
-    std::string inputFile  = argv[2];  // Input file path
-    std::string outputFile = argv[3];  // Output file path
+    std::string mode = argv[1];  // -c, -d, -a, -u, -x, -l or -e
+    int maxCodeLength = CanonicalCode::DEFAULT_MAX_CODE_LENGTH;
+    int threadCount = 0;
+    long long rangeOffset = 0;
+    long long rangeLength = -1;
+    bool rangeRequested = false;
+    bool verifyContents = false;
+    std::vector<std::string> paths;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-L" && i + 1 < argc) {
+            maxCodeLength = std::atoi(argv[++i]);
+            if (maxCodeLength < 1 || maxCodeLength > CanonicalCode::MAX_CODE_LENGTH) {
+                std::cerr << "Invalid code length limit: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (arg == "-T" && i + 1 < argc) {
+            threadCount = std::atoi(argv[++i]);
+            if (threadCount < 0 || threadCount > 1024) {
+                std::cerr << "Invalid thread count: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if ((arg == "-O" || arg == "-N") && i + 1 < argc) {
+            char* end = nullptr;
+            long long value = std::strtoll(argv[++i], &end, 10);
+            if (*end != '\0' || (arg == "-N" && value < 0)) {
+                std::cerr << "Invalid " << (arg == "-O" ? "offset" : "length") << ": " << argv[i] << "\n";
+                return 1;
+            }
+            (arg == "-O" ? rangeOffset : rangeLength) = value;
+            rangeRequested = true;
+        } else if (arg == "-H") {
+            verifyContents = true;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+
+    // Listing takes only the archive; extracting a member also names it
+    size_t expectedPaths = mode == "-l" ? 1 : mode == "-e" ? 3 : 2;
+    if (paths.size() != expectedPaths) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string inputFile  = paths.front();  // Input file path
+    std::string outputFile = paths.back();   // Output file path
+    bool inputIsStdin = inputFile == "-";
+    bool outputIsStdout = outputFile == "-";
+
+    if (inputIsStdin || outputIsStdout) {
+        std::ios::sync_with_stdio(false);  // Bulk reads and writes skip the C stdio layer
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    if (outputIsStdout) console = &std::cerr;
+
+    // Streams are read front to back; the other side may still be a file
+    std::ifstream inputFileStream;
+    std::ofstream outputFileStream;
+    auto openStreams = [&]() {
+        if (!inputIsStdin) inputFileStream.open(inputFile, std::ios::binary);
+        if (!outputIsStdout) outputFileStream.open(outputFile, std::ios::binary);
+        if (!inputIsStdin && !inputFileStream.is_open()) {
+            std::cerr << "Error: " << getErrorMessage(ErrorCode::FileNotFound) << "\n";
+            return false;
+        }
+        if (!outputIsStdout && !outputFileStream.is_open()) {
+            std::cerr << "Error: " << getErrorMessage(ErrorCode::FileCreateError) << "\n";
+            return false;
+        }
+        return true;
+    };
+    std::istream& inputStream = inputIsStdin ? std::cin : static_cast<std::istream&>(inputFileStream);
+    std::ostream& outputStream = outputIsStdout ? std::cout : static_cast<std::ostream&>(outputFileStream);
 
     if (mode == "-c") {
         // ===== COMPRESSION MODE =====
         Compressor compressor;
-        HuffmanTree tree;
 
         // Set up callbacks
         compressor.setLogger(consoleLogger);
         compressor.setProgressCallback(consoleProgress);
 
-        // Step 1: Build frequency map from input file
-        ErrorCode result = compressor.readFileAndBuildFrequency(inputFile);
-        if (result != ErrorCode::Success) {
-            std::cerr << "Error: " << getErrorMessage(result) << "\n";
-            return 1;
-        }
-
-        // Step 2: Build Huffman tree from frequency map
-        tree.build(compressor.getFrequencyMap());
-
-        // Step 3: Generate Huffman codes from tree
-        tree.generateCodes();
+        compressor.setMaxCodeLength(maxCodeLength);
+        compressor.setThreadCount(static_cast<unsigned>(threadCount));
 
-        // Step 4: Compress input using Huffman codes
-        result = compressor.compressFile(inputFile, outputFile, tree.getHuffmanCodes(), tree.getRoot());
+        // Read, code and write the input block by block in a single pass
+        ErrorCode result;
+        if (inputIsStdin || outputIsStdout) {
+            if (!openStreams()) return 1;
+            result = compressor.compress(inputStream, outputStream);
+        } else {
+            result = compressor.compress(inputFile, outputFile);
+        }
         if (result != ErrorCode::Success) {
             std::cerr << "Error: " << getErrorMessage(result) << "\n";
             return 1;
@@ -79,9 +179,89 @@ int main(int argc, char* argv[]) {
         // Set up callbacks
         decompressor.setLogger(consoleLogger);
         decompressor.setProgressCallback(consoleProgress);
+        decompressor.setThreadCount(static_cast<unsigned>(threadCount));
+
+        ErrorCode result;
+        if (rangeRequested && (inputIsStdin || outputIsStdout)) {
+            std::cerr << "Byte ranges need a compressed file and an output file, not -\n";
+            return 1;
+        } else if (inputIsStdin || outputIsStdout) {
+            // Front to back in bounded memory; the block index is not needed
+            if (!openStreams()) return 1;
+            result = decompressor.decompress(inputStream, outputStream);
+        } else if (rangeRequested) {
+            // Only the blocks overlapping the range are decoded
+            uint64_t offset = static_cast<uint64_t>(rangeOffset);
+            if (rangeOffset < 0) {
+                uint64_t size = 0;
+                result = decompressor.readContentSize(inputFile, size);
+                if (result != ErrorCode::Success) {
+                    std::cerr << "Error: " << getErrorMessage(result) << "\n";
+                    return 1;
+                }
+                uint64_t back = static_cast<uint64_t>(-rangeOffset);
+                offset = back < size ? size - back : 0;
+            }
+            uint64_t length = rangeLength < 0 ? UINT64_MAX : static_cast<uint64_t>(rangeLength);
+            result = decompressor.decompressRange(inputFile, offset, length, outputFile);
+        } else {
+            // Step 1: Decompress the file using Huffman decoding
+            result = decompressor.decompressFile(inputFile, outputFile);
+        }
+        if (result != ErrorCode::Success) {
+            std::cerr << "Error: " << getErrorMessage(result) << "\n";
+            return 1;
+        }
+
+    } else if (mode == "-a" || mode == "-u" || mode == "-x" || mode == "-l" || mode == "-e") {
+        // ===== ARCHIVE MODES =====
+        if (inputIsStdin || outputIsStdout || rangeRequested) {
+            std::cerr << "Archives need a directory and an archive file\n";
+            return 1;
+        }
 
-        // Step 1: Decompress the file using Huffman decoding
-        ErrorCode result = decompressor.decompressFile(inputFile, outputFile);
+        if (mode == "-l") {
+            // Only the central directory is read
+            std::vector<ArchiveEntry> entries;
+            ErrorCode result = Archiver::listArchive(inputFile, entries);
+            if (result != ErrorCode::Success) {
+                std::cerr << "Error: " << getErrorMessage(result) << "\n";
+                return 1;
+            }
+            std::cout << std::setw(14) << "Size" << std::setw(14) << "Stored" << "  CRC32     Name\n";
+            for (const ArchiveEntry& entry : entries) {
+                std::cout << std::setw(14) << entry.size << std::setw(14) << entry.storedSize << "  "
+                          << std::hex << std::setfill('0') << std::setw(8) << entry.crc
+                          << std::dec << std::setfill(' ') << "  " << entry.name;
+                if (entry.flags & HPA_MEMBER_DUPLICATE) {
+                    std::cout << " (same as " << entries[static_cast<size_t>(entry.source)].name << ")";
+                } else if (entry.flags & HPA_MEMBER_SOLID) {
+                    std::cout << " (shares table of " << entries[static_cast<size_t>(entry.source)].name << ")";
+                }
+                std::cout << "\n";
+            }
+            return 0;
+        }
+
+        ArchiveOptions options;
+        options.threads = static_cast<unsigned>(threadCount);
+        options.maxCodeLength = maxCodeLength;
+        options.verifyContents = verifyContents;
+        options.logger = consoleLogger;
+        options.progress = consoleProgress;
+
+        ErrorCode result;
+        if (mode == "-a") {
+            result = Archiver::compressDirectory(inputFile, outputFile, options);
+        } else if (mode == "-u") {
+            // Only new and changed files are compressed
+            result = Archiver::updateArchive(inputFile, outputFile, options);
+        } else if (mode == "-x") {
+            result = Archiver::extractArchive(inputFile, outputFile, options);
+        } else {
+            // Only the central directory and the one member are read
+            result = Archiver::extractMember(inputFile, paths[1], outputFile, options);
+        }
         if (result != ErrorCode::Success) {
             std::cerr << "Error: " << getErrorMessage(result) << "\n";
             return 1;
@@ -90,7 +270,8 @@ int main(int argc, char* argv[]) {
     } else {
         // Invalid operation mode
         std::cerr << "Invalid mode: " << mode << "\n";
-        std::cerr << "Use -c to compress or -d to decompress.\n";
+        std::cerr << "Use -c to compress, -d to decompress, -a to archive a directory, -u to update an archive,\n"
+                  << "-x to extract one, -l to list an archive or -e to extract a single member.\n";
         return 1;
     }
 
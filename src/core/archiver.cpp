@@ -1,10 +1,34 @@
 #include "archiver.h"
+#include "inputSource.h"
+#include "blockCodec.h"
+#include "bytePipe.h"
+#include "crc32.h"
+#include "decompressor.h"
+#include "histogram.h"
+#include "hpfFormat.h"
+#include "hpaFormat.h"
+#include "manifest.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
 
 namespace fs = std::filesystem;
 
+// Longer stored paths can only come from a corrupted archive
+static const uint64_t MAX_PATH_LENGTH = 64 * 1024;
+
 // Helper to write 64-bit integer
 void writeUint64(std::ofstream& out, uint64_t val) {
     for (int i = 0; i < 8; ++i) {
@@ -21,72 +45,93 @@ uint64_t readUint64(std::ifstream& in) {
     return val;
 }
 
-ErrorCode Archiver::archiveDirectory(const std::string& directoryPath, const std::string& outputFilename) {
-    if (!fs::exists(directoryPath) || !fs::is_directory(directoryPath)) {
-        return ErrorCode::FileNotFound;
+// Same, from an InputSource; false if the input ends first
+static bool readUint64(InputSource& in, uint64_t& val) {
+    const unsigned char* bytes;
+    if (in.next(bytes, 8) != 8) return false;
+    val = 0;
+    for (int i = 0; i < 8; ++i) {
+        val |= static_cast<uint64_t>(bytes[i]) << (i * 8);
     }
+    return true;
+}
+
+ErrorCode Archiver::archiveDirectory(const std::string& directoryPath, const std::string& outputFilename) {
+    // Collect all files
+    Manifest manifest;
+    ErrorCode scanned = manifest.scan(directoryPath);
+    if (scanned != ErrorCode::Success) return scanned;
 
     std::ofstream out(outputFilename, std::ios::binary);
     if (!out.is_open()) return ErrorCode::FileCreateError;
 
-    // Collect all files
-    std::vector<fs::path> files;
-    for (const auto& entry : fs::recursive_directory_iterator(directoryPath)) {
-        if (entry.is_regular_file()) {
-            files.push_back(entry.path());
-        }
-    }
-
     // Write Magic Header
-    out.write("HUFFARCH", 8);
+    out.write(LEGACY_ARCHIVE_MAGIC, sizeof(LEGACY_ARCHIVE_MAGIC));
 
     // Write file count
-    writeUint64(out, files.size());
+    writeUint64(out, manifest.entries().size());
 
-    for (const auto& filePath : files) {
-        // Get relative path
-        std::string relPath = fs::relative(filePath, directoryPath).generic_string();
-        uint64_t pathLen = relPath.size();
-        uint64_t fileSize = fs::file_size(filePath);
+    std::vector<char> buffer(1024 * 1024);
+    for (const ManifestEntry& file : manifest.entries()) {
+        std::string_view relPath = manifest.name(file);
 
         // Write path length and path
-        writeUint64(out, pathLen);
-        out.write(relPath.c_str(), pathLen);
+        writeUint64(out, relPath.size());
+        out.write(relPath.data(), relPath.size());
 
         // Write file size
-        writeUint64(out, fileSize);
+        writeUint64(out, file.size);
 
-        // Write content
-        std::ifstream inFile(filePath, std::ios::binary);
+        // Write content: exactly the size recorded above, even if the file changed since
+        std::ifstream inFile(manifest.path(file), std::ios::binary);
         if (!inFile.is_open()) return ErrorCode::FileNotFound;
-        out << inFile.rdbuf();
+        uint64_t remaining = file.size;
+        while (remaining > 0) {
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(buffer.size(), remaining));
+            if (!inFile.read(buffer.data(), chunk)) return ErrorCode::FileReadError;
+            out.write(buffer.data(), chunk);
+            remaining -= chunk;
+        }
     }
 
-    return ErrorCode::Success;
+    return out ? ErrorCode::Success : ErrorCode::FileWriteError;
 }
 
-ErrorCode Archiver::extractArchive(const std::string& archiveFilename, const std::string& outputDirectory) {
-    std::ifstream in(archiveFilename, std::ios::binary);
-    if (!in.is_open()) return ErrorCode::FileNotFound;
-
-    fs::create_directories(outputDirectory);
+// Rejects stored paths that would land outside the output directory
+static bool isSafeMemberPath(const std::string& name) {
+    fs::path path(name);
+    if (name.empty() || path.has_root_name() || path.has_root_directory()) return false;
+    for (const fs::path& part : path) {
+        if (part == "..") return false;
+    }
+    return true;
+}
 
-    char magic[8];
-    in.read(magic, 8);
-    if (std::string(magic, 8) != "HUFFARCH") {
+// Uncompressed HUFFARCH bundle, as written by archiveDirectory
+static ErrorCode extractLegacyArchive(InputSource& in, const std::string& outputDirectory) {
+    const unsigned char* magic;
+    if (in.next(magic, sizeof(LEGACY_ARCHIVE_MAGIC)) != sizeof(LEGACY_ARCHIVE_MAGIC) ||
+        !std::equal(std::begin(LEGACY_ARCHIVE_MAGIC), std::end(LEGACY_ARCHIVE_MAGIC), magic)) {
         return ErrorCode::UnknownError; // Not an archive
     }
 
-    uint64_t fileCount = readUint64(in);
+    uint64_t fileCount;
+    if (!readUint64(in, fileCount)) return ErrorCode::FileReadError;
 
     for (uint64_t i = 0; i < fileCount; ++i) {
         // Read path
-        uint64_t pathLen = readUint64(in);
-        std::string relPath(pathLen, '\0');
-        in.read(&relPath[0], pathLen);
+        uint64_t pathLen;
+        const unsigned char* pathBytes;
+        if (!readUint64(in, pathLen) || pathLen > MAX_PATH_LENGTH ||
+            in.next(pathBytes, static_cast<size_t>(pathLen)) != pathLen) {
+            return ErrorCode::FileReadError;
+        }
+        std::string relPath(reinterpret_cast<const char*>(pathBytes), static_cast<size_t>(pathLen));
+        if (!isSafeMemberPath(relPath)) return ErrorCode::InvalidFormat;
 
         // Read size
-        uint64_t fileSize = readUint64(in);
+        uint64_t fileSize;
+        if (!readUint64(in, fileSize)) return ErrorCode::FileReadError;
 
         // Prepare output file
         fs::path outPath = fs::path(outputDirectory) / relPath;
@@ -95,19 +140,1367 @@ ErrorCode Archiver::extractArchive(const std::string& archiveFilename, const std
         std::ofstream outFile(outPath, std::ios::binary);
         if (!outFile.is_open()) return ErrorCode::FileCreateError;
 
-        // Copy content
-        // We can't use rdbuf directly because we need to read exactly fileSize bytes
-        // and the stream continues after that.
-        const size_t BUFFER_SIZE = 4096;
-        char buffer[BUFFER_SIZE];
+        // Copy content. A mapped archive is written straight from the mapping;
+        // otherwise the source buffers one chunk at a time.
+        const size_t CHUNK_SIZE = 1024 * 1024; // 1MB
         uint64_t remaining = fileSize;
         while (remaining > 0) {
-            size_t toRead = std::min(static_cast<uint64_t>(BUFFER_SIZE), remaining);
-            in.read(buffer, toRead);
-            outFile.write(buffer, toRead);
-            remaining -= toRead;
+            const unsigned char* chunk;
+            size_t wanted = static_cast<size_t>(std::min<uint64_t>(CHUNK_SIZE, remaining));
+            size_t got = in.next(chunk, wanted);
+            outFile.write(reinterpret_cast<const char*>(chunk), got);
+            if (got < wanted) return ErrorCode::FileReadError;
+            remaining -= got;
+        }
+        if (!outFile) return ErrorCode::FileWriteError;
+    }
+
+    return ErrorCode::Success;
+}
+
+// Extracts a compressed bundle, as HuffPressor 1.0 wrote archives: the bundle
+// is decoded on another thread into a pipe the extractor reads from, so it is
+// never written to disk and only a few chunks of it are held in memory
+static ErrorCode extractCompressedBundle(const std::string& archiveFilename, const std::string& outputDirectory) {
+    std::ifstream file(archiveFilename, std::ios::binary);
+    if (!file.is_open()) return ErrorCode::FileNotFound;
+
+    BytePipe pipe;
+    ErrorCode decoded = ErrorCode::Success;
+    ThreadPool pool(1);
+    std::future<void> decoding = pool.submit([&]() {
+        std::ostream bundle(pipe.output());
+        Decompressor decompressor;
+        try {
+            decoded = decompressor.decompress(file, bundle);
+        } catch (...) {
+            decoded = ErrorCode::DecompressionFailed;
+        }
+        // Always, or the extractor would wait for more forever
+        pipe.closeWrite();
+    });
+
+    std::istream bundle(pipe.input());
+    InputSource in;
+    in.attach(bundle);
+    ErrorCode result = extractLegacyArchive(in, outputDirectory);
+
+    // Stops the decoder if the extractor is done before it
+    pipe.closeRead();
+    decoding.get();
+
+    // A write error only means the extractor stopped reading; any other
+    // decoding error explains why the bundle was cut short
+    if (decoded != ErrorCode::Success && decoded != ErrorCode::FileWriteError) return decoded;
+    return result;
+}
+
+// Appends the central directory and the trailer that locates it
+static void writeDirectory(const std::vector<ArchiveEntry>& entries, uint64_t directoryOffset,
+                           std::vector<unsigned char>& out) {
+    writeVarint(out, entries.size());
+    for (const ArchiveEntry& entry : entries) {
+        out.push_back(entry.flags);
+        writeVarint(out, entry.name.size());
+        out.insert(out.end(), entry.name.begin(), entry.name.end());
+        writeVarint(out, entry.size);
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<unsigned char>(entry.crc >> shift));
+        }
+        writeVarint(out, entry.offset);
+        writeVarint(out, entry.storedSize);
+        if (entry.flags) writeVarint(out, entry.source);
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<unsigned char>(static_cast<uint64_t>(entry.modified) >> shift));
+        }
+    }
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<unsigned char>(directoryOffset >> shift));
+    }
+    out.insert(out.end(), std::begin(HPA_DIRECTORY_MAGIC), std::end(HPA_DIRECTORY_MAGIC));
+}
+
+// Loads the central directory through the trailer at the end of a seekable
+// stream, and the archive version from its header. Returns false if there is
+// no directory or it does not describe a valid archive.
+static bool readDirectory(std::istream& input, std::vector<ArchiveEntry>& entries, int& version) {
+    entries.clear();
+
+    unsigned char magic[sizeof(HPA_MAGIC) + 1];
+    input.seekg(0);
+    if (!input.read(reinterpret_cast<char*>(magic), sizeof(magic)) ||
+        !std::equal(std::begin(HPA_MAGIC), std::end(HPA_MAGIC), magic) ||
+        magic[sizeof(HPA_MAGIC)] < HPA_VERSION_FIRST || magic[sizeof(HPA_MAGIC)] > HPA_VERSION) {
+        return false;
+    }
+    version = magic[sizeof(HPA_MAGIC)];
+    const unsigned char knownFlags = version >= 2 ? HPA_MEMBER_DUPLICATE | HPA_MEMBER_SOLID : 0;
+
+    input.seekg(0, std::ios::end);
+    std::streamoff fileSize = input.tellg();
+    if (fileSize < HPA_TRAILER_SIZE) return false;
+
+    unsigned char trailer[HPA_TRAILER_SIZE];
+    input.seekg(fileSize - HPA_TRAILER_SIZE);
+    if (!input.read(reinterpret_cast<char*>(trailer), HPA_TRAILER_SIZE)) return false;
+    if (!std::equal(std::begin(HPA_DIRECTORY_MAGIC), std::end(HPA_DIRECTORY_MAGIC), trailer + 8)) return false;
+
+    uint64_t directoryOffset = 0;
+    for (int i = 0; i < 8; ++i) {
+        directoryOffset = (directoryOffset << 8) | trailer[i];
+    }
+    if (directoryOffset > static_cast<uint64_t>(fileSize - HPA_TRAILER_SIZE)) return false;
+
+    std::vector<unsigned char> bytes(static_cast<size_t>(fileSize - HPA_TRAILER_SIZE - directoryOffset));
+    input.seekg(static_cast<std::streamoff>(directoryOffset));
+    if (!input.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return false;
+
+    BitReader reader(bytes.data(), bytes.size());
+    uint64_t count;
+    if (!readVarint(reader, count) || count > bytes.size()) return false;
+
+    entries.resize(static_cast<size_t>(count));
+    for (size_t i = 0; i < entries.size(); ++i) {
+        ArchiveEntry& entry = entries[i];
+        uint64_t nameLength;
+        unsigned char crc[4];
+        if (!reader.readByte(entry.flags) || (entry.flags & ~knownFlags) ||
+            !readVarint(reader, nameLength) || nameLength > MAX_PATH_LENGTH) {
+            return false;
+        }
+        entry.name.resize(static_cast<size_t>(nameLength));
+        if (!reader.readBytes(reinterpret_cast<unsigned char*>(entry.name.data()), entry.name.size()) ||
+            !readVarint(reader, entry.size) || !reader.readBytes(crc, sizeof(crc)) ||
+            !readVarint(reader, entry.offset) || !readVarint(reader, entry.storedSize)) {
+            return false;
+        }
+        entry.crc = static_cast<uint32_t>(crc[0]) << 24 | static_cast<uint32_t>(crc[1]) << 16 |
+                    static_cast<uint32_t>(crc[2]) << 8 | crc[3];
+        if (entry.storedSize > directoryOffset || entry.offset > directoryOffset - entry.storedSize) {
+            return false;
+        }
+
+        // A duplicate refers back to an earlier member with the same contents,
+        // a solid member to the first member of its group
+        if (entry.flags == (HPA_MEMBER_DUPLICATE | HPA_MEMBER_SOLID)) return false;
+        if (entry.flags) {
+            if (!readVarint(reader, entry.source) || entry.source >= i) return false;
+            const ArchiveEntry& source = entries[static_cast<size_t>(entry.source)];
+            if ((entry.flags & HPA_MEMBER_DUPLICATE) &&
+                ((source.flags & HPA_MEMBER_DUPLICATE) || source.size != entry.size || source.crc != entry.crc)) {
+                return false;
+            }
+            if ((entry.flags & HPA_MEMBER_SOLID) && source.flags != 0) return false;
+        }
+
+        entry.modified = 0;
+        if (version >= 3) {
+            unsigned char modified[8];
+            if (!reader.readBytes(modified, sizeof(modified))) return false;
+            uint64_t time = 0;
+            for (unsigned char byte : modified) {
+                time = (time << 8) | byte;
+            }
+            entry.modified = static_cast<int64_t>(time);
+        }
+    }
+    return true;
+}
+
+// CRC-32 of a whole file; false if it cannot be read
+static bool checksumFile(const fs::path& path, uint32_t& crc) {
+    InputSource in;
+    if (in.open(path.string()) != ErrorCode::Success) return false;
+
+    crc = 0;
+    const unsigned char* chunk;
+    while (size_t got = in.next(chunk, BlockCodec::DEFAULT_BLOCK_SIZE)) {
+        crc = crc32Update(crc, chunk, got);
+    }
+    return true;
+}
+
+// True if two files of `size` bytes hold the same bytes
+static bool sameContents(const fs::path& a, const fs::path& b, uint64_t size) {
+    InputSource first, second;
+    if (first.open(a.string()) != ErrorCode::Success || second.open(b.string()) != ErrorCode::Success) return false;
+
+    while (size > 0) {
+        const unsigned char *chunkA, *chunkB;
+        size_t wanted = static_cast<size_t>(std::min<uint64_t>(BlockCodec::DEFAULT_BLOCK_SIZE, size));
+        if (first.next(chunkA, wanted) != wanted || second.next(chunkB, wanted) != wanted ||
+            std::memcmp(chunkA, chunkB, wanted) != 0) {
+            return false;
+        }
+        size -= wanted;
+    }
+    return true;
+}
+
+// What an earlier archive records about a file that has not changed since
+struct KnownContents {
+    uint64_t member = UINT64_MAX;  // Entry holding the file's contents; UINT64_MAX if not known
+    uint32_t crc = 0;
+};
+
+// Finds files with the same contents as an earlier one: `firstCopy[i]` receives
+// the index of the first file with the contents of file i, or i itself. Only
+// files that share their size with another are read. They are checksummed in
+// parallel, and files with the same checksum are then compared byte for byte,
+// so a collision can never merge different files. Files that cannot be read
+// are left to fail when they are compressed.
+// Files `known` from an earlier archive are not read at all: their checksum is
+// on record, and two of them have the same contents exactly when the archive
+// stored them in the same member.
+static void findDuplicates(const Manifest& manifest, ThreadPool& pool, std::vector<size_t>& firstCopy,
+                           const std::vector<KnownContents>& known = {}) {
+    const std::vector<ManifestEntry>& files = manifest.entries();
+    firstCopy.resize(files.size());
+    for (size_t i = 0; i < files.size(); ++i) {
+        firstCopy[i] = i;
+    }
+
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (files[i].size > 0) candidates.push_back(i);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [&](size_t a, size_t b) { return files[a].size < files[b].size; });
+
+    // Drop the files whose size is unique
+    std::vector<size_t> sameSize;
+    for (size_t begin = 0, end; begin < candidates.size(); begin = end) {
+        for (end = begin + 1; end < candidates.size() && files[candidates[end]].size == files[candidates[begin]].size;) {
+            ++end;
+        }
+        if (end - begin > 1) sameSize.insert(sameSize.end(), candidates.begin() + begin, candidates.begin() + end);
+    }
+    if (sameSize.empty()) return;
+
+    std::vector<uint32_t> crcs(files.size());
+    std::vector<char> readable(files.size());
+    std::vector<std::future<void>> tasks;
+    auto isKnown = [&](size_t i) { return !known.empty() && known[i].member != UINT64_MAX; };
+    for (size_t i : sameSize) {
+        if (isKnown(i)) {
+            crcs[i] = known[i].crc;
+            readable[i] = true;
+            continue;
+        }
+        tasks.push_back(pool.submit([&, i]() { readable[i] = checksumFile(manifest.path(files[i]), crcs[i]); }));
+    }
+    for (std::future<void>& task : tasks) {
+        task.get();
+    }
+
+    // Runs of equal size and checksum, in archive order within each run
+    std::vector<size_t> matching;
+    for (size_t i : sameSize) {
+        if (readable[i]) matching.push_back(i);
+    }
+    std::stable_sort(matching.begin(), matching.end(), [&](size_t a, size_t b) {
+        return files[a].size != files[b].size ? files[a].size < files[b].size : crcs[a] < crcs[b];
+    });
+
+    tasks.clear();
+    for (size_t begin = 0, end; begin < matching.size(); begin = end) {
+        size_t first = matching[begin];
+        for (end = begin + 1; end < matching.size() && files[matching[end]].size == files[first].size &&
+                              crcs[matching[end]] == crcs[first];) {
+            ++end;
+        }
+        if (end - begin < 2) continue;
+
+        // Each run is settled by one task, which only touches its own files
+        tasks.push_back(pool.submit([&, begin, end]() {
+            std::vector<size_t> distinct;
+            for (size_t k = begin; k < end; ++k) {
+                size_t file = matching[k];
+                for (size_t original : distinct) {
+                    bool same = isKnown(original) && isKnown(file)
+                                    ? known[original].member == known[file].member
+                                    : sameContents(manifest.path(files[original]), manifest.path(files[file]),
+                                                   files[file].size);
+                    if (same) {
+                        firstCopy[file] = original;
+                        break;
+                    }
+                }
+                if (firstCopy[file] == file) distinct.push_back(file);
+            }
+        }));
+    }
+    for (std::future<void>& task : tasks) {
+        task.get();
+    }
+}
+
+// Files up to this size are grouped with similar ones under a shared table
+static const uint64_t SOLID_MAX_MEMBER_SIZE = 64 * 1024;
+// Raw bytes per solid group: the group is read and coded as one task
+static const uint64_t SOLID_MAX_GROUP_SIZE = BlockCodec::DEFAULT_BLOCK_SIZE;
+
+// How the files of a manifest are laid out as archive members
+struct ArchivePlan {
+    std::vector<size_t> order;          // Manifest index of every member, in archive order
+    std::vector<unsigned char> flags;   // HPA_MEMBER_* of every member
+    std::vector<size_t> source;         // Member a duplicate or solid member refers to
+    std::vector<size_t> groupSize;      // Members in the solid group a member starts, or 1
+    size_t duplicates = 0;
+    size_t groups = 0;
+};
+
+// Lowercased extension of a member name, which solid groups are formed by
+static std::string extensionOf(std::string_view name) {
+    std::string extension = fs::path(name).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension;
+}
+
+// Orders the members and sets their references. Files keep their name order,
+// except that with `solid` the small files sharing an extension are pulled
+// together into groups of up to SOLID_MAX_GROUP_SIZE, placed where their first
+// file would be. Files only ever move forward that way, so every duplicate
+// still comes after its first copy.
+static void planArchive(const Manifest& manifest, const std::vector<size_t>& firstCopy, bool solid,
+                        ArchivePlan& plan) {
+    const std::vector<ManifestEntry>& files = manifest.entries();
+    const size_t NONE = SIZE_MAX;
+
+    std::vector<std::vector<size_t>> groups;
+    std::vector<size_t> groupOf(files.size(), NONE);
+    if (solid) {
+        std::map<std::string, std::vector<size_t>> byExtension;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (firstCopy[i] == i && files[i].size > 0 && files[i].size <= SOLID_MAX_MEMBER_SIZE) {
+                byExtension[extensionOf(manifest.name(files[i]))].push_back(i);
+            }
+        }
+        for (const auto& [extension, candidates] : byExtension) {
+            std::vector<size_t> group;
+            uint64_t groupBytes = 0;
+            for (size_t k = 0; k <= candidates.size(); ++k) {
+                bool full = k == candidates.size() || groupBytes + files[candidates[k]].size > SOLID_MAX_GROUP_SIZE;
+                if (full && !group.empty()) {
+                    if (group.size() > 1) {
+                        for (size_t member : group) {
+                            groupOf[member] = groups.size();
+                        }
+                        groups.push_back(group);
+                    }
+                    group.clear();
+                    groupBytes = 0;
+                }
+                if (k < candidates.size()) {
+                    group.push_back(candidates[k]);
+                    groupBytes += files[candidates[k]].size;
+                }
+            }
+        }
+    }
+
+    std::vector<size_t> position(files.size(), NONE);
+    plan.order.clear();
+    plan.groupSize.assign(files.size(), 1);
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (position[i] != NONE) continue;
+        if (groupOf[i] == NONE) {
+            position[i] = plan.order.size();
+            plan.order.push_back(i);
+            continue;
+        }
+        const std::vector<size_t>& group = groups[groupOf[i]];
+        plan.groupSize[plan.order.size()] = group.size();
+        for (size_t member : group) {
+            position[member] = plan.order.size();
+            plan.order.push_back(member);
+        }
+    }
+
+    plan.flags.assign(files.size(), 0);
+    plan.source.assign(files.size(), 0);
+    plan.duplicates = 0;
+    plan.groups = groups.size();
+    for (size_t p = 0; p < plan.order.size(); ++p) {
+        size_t i = plan.order[p];
+        if (firstCopy[i] != i) {
+            plan.flags[p] = HPA_MEMBER_DUPLICATE;
+            plan.source[p] = position[firstCopy[i]];
+            ++plan.duplicates;
+        } else if (groupOf[i] != NONE && groups[groupOf[i]].front() != i) {
+            plan.flags[p] = HPA_MEMBER_SOLID;
+            plan.source[p] = position[groups[groupOf[i]].front()];
+        }
+    }
+}
+
+// Lists the files of the directory to archive, in name order, so archives of
+// the same tree are identical
+static ErrorCode scanDirectory(const std::string& directoryPath, const ArchiveOptions& options, Manifest& manifest) {
+    const LogCallback& logger = options.logger;
+    ErrorCode scanned = manifest.scan(directoryPath, options.threads);
+    if (scanned == ErrorCode::FileNotFound) {
+        if (logger) logger("Error: Not a directory: " + directoryPath + "\n");
+    } else if (scanned != ErrorCode::Success) {
+        if (logger) logger("Error: Could not read all of " + directoryPath + "\n");
+    }
+    return scanned;
+}
+
+// An existing archive that an update copies unchanged members from
+struct PreviousArchive {
+    std::string filename;
+    int version = 0;
+    std::vector<ArchiveEntry> entries;
+    std::vector<size_t> unchanged;  // Per manifest file: its entry if the file has not changed, else SIZE_MAX
+};
+
+// Where the blocks of a member start, after the header in front of them
+static uint64_t memberDataOffset(const ArchiveEntry& entry, int version) {
+    std::vector<unsigned char> header;
+    writeVarint(header, entry.name.size());
+    writeVarint(header, entry.size);
+    if (version >= 2) {
+        header.push_back(entry.flags);
+        if (entry.flags) writeVarint(header, entry.source);
+    }
+    return entry.offset + header.size() + entry.name.size();
+}
+
+// Appends `count` coded bytes stored at `from` to `out`; with `last`, they
+// must be followed by the member's end marker
+static ErrorCode readStoredBytes(std::ifstream& in, uint64_t from, size_t count, bool last,
+                                 std::vector<unsigned char>& out) {
+    size_t start = out.size();
+    out.resize(start + count + (last ? 1 : 0));
+    in.clear();
+    in.seekg(static_cast<std::streamoff>(from));
+    in.read(reinterpret_cast<char*>(out.data() + start), out.size() - start);
+    if (!in) return ErrorCode::FileReadError;
+    if (last) {
+        if (out.back() != HPF_BLOCK_END) return ErrorCode::InvalidFormat;
+        out.pop_back();
+    }
+    return ErrorCode::Success;
+}
+
+// Writes the files of `manifest` as a native archive. With a `previous`
+// archive, members of unchanged files are copied from it where they stand on
+// their own, or with their whole solid group; everything else is coded anew.
+static ErrorCode writeArchive(const Manifest& manifest, const std::string& outputFilename,
+                              const ArchiveOptions& options, const PreviousArchive* previous) {
+    const LogCallback& logger = options.logger;
+    const std::vector<ManifestEntry>& files = manifest.entries();
+    const uint64_t totalSize = manifest.totalSize();
+
+    std::ofstream out(outputFilename, std::ios::binary);
+    if (!out.is_open()) {
+        if (logger) logger("Error: Cannot create output file: " + outputFilename + "\n");
+        return ErrorCode::FileCreateError;
+    }
+
+    std::vector<unsigned char> header(std::begin(HPA_MAGIC), std::end(HPA_MAGIC));
+    header.push_back(HPA_VERSION);
+    writeVarint(header, files.size());
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    // Every block of every file is one task; files of up to a block and whole
+    // solid groups are a single task. Members copied from a previous archive
+    // are read in chunks of a block. Results are written back in order, a few
+    // per thread in flight.
+    struct PendingBlock {
+        size_t position = 0;  // Of the (first) member in the archive
+        size_t members = 1;   // More than one for a solid group
+        uint64_t offset = 0;  // In the file, or in the previous archive for a copy
+        size_t size = 0;
+        bool first = false, last = false;
+        bool copied = false;  // Coded bytes taken from the previous archive
+        uint32_t crc = 0;
+        std::vector<unsigned char> data;
+        std::vector<unsigned char> encoded;
+        std::vector<size_t> ends;     // Solid group: where each member's block ends in `encoded`
+        std::vector<uint32_t> crcs;   // and its checksum
+        ErrorCode result = ErrorCode::Success;
+        std::future<void> done;
+    };
+
+    const size_t blockSize = BlockCodec::DEFAULT_BLOCK_SIZE;
+    const unsigned threads = options.threads > 0 ? options.threads : ThreadPool::hardwareThreads();
+    const size_t maxInFlight = 4 * static_cast<size_t>(threads);
+    const int maxCodeLength = options.maxCodeLength;
+
+    // Declared before the pool so a pool unwinding on error never outlives the blocks
+    std::deque<std::unique_ptr<PendingBlock>> inFlight;
+    std::vector<std::unique_ptr<PendingBlock>> spare;
+    ThreadPool pool(threads);
+
+    // Duplicates are written as a reference to their first copy and never coded
+    std::vector<KnownContents> known;
+    if (previous) {
+        known.resize(files.size());
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (previous->unchanged[i] == SIZE_MAX) continue;
+            const ArchiveEntry& entry = previous->entries[previous->unchanged[i]];
+            known[i].member = (entry.flags & HPA_MEMBER_DUPLICATE) ? entry.source : previous->unchanged[i];
+            known[i].crc = entry.crc;
         }
     }
+    std::vector<size_t> firstCopy;
+    findDuplicates(manifest, pool, firstCopy, known);
+    ArchivePlan plan;
+    planArchive(manifest, firstCopy, options.solid, plan);
+
+    // The previous entry of the member at `position` if its coded bytes can be
+    // copied as they are: the file is unchanged and the entry holds its own
+    // data, or (`groupFirst`) shares the table of that entry's group
+    auto copyableEntry = [&](size_t position, const ArchiveEntry* groupFirst) -> const ArchiveEntry* {
+        size_t index = previous ? previous->unchanged[plan.order[position]] : SIZE_MAX;
+        if (index == SIZE_MAX) return nullptr;
+        const ArchiveEntry& entry = previous->entries[index];
+        if (memberDataOffset(entry, previous->version) >= entry.offset + entry.storedSize) return nullptr;
+        if (!groupFirst) return entry.flags == 0 ? &entry : nullptr;
+        bool sharesTable = (entry.flags & HPA_MEMBER_SOLID) &&
+                           &previous->entries[static_cast<size_t>(entry.source)] == groupFirst;
+        return sharesTable ? &entry : nullptr;
+    };
+    size_t copiedMembers = 0;
+
+    ErrorCode result = ErrorCode::Success;
+    uint64_t bytesDone = 0;
+    uint64_t bytesWritten = header.size();
+    std::vector<ArchiveEntry> entries;
+    entries.reserve(files.size());
+
+    auto writeMemberHeader = [&](size_t position) {
+        const ManifestEntry& file = files[plan.order[position]];
+        std::string_view name = manifest.name(file);
+        unsigned char flags = plan.flags[position];
+        uint64_t source = flags ? plan.source[position] : 0;
+        entries.push_back({flags, std::string(name), file.size, 0, bytesWritten, 0, source, file.modified});
+
+        header.clear();
+        writeVarint(header, name.size());
+        header.insert(header.end(), name.begin(), name.end());
+        writeVarint(header, file.size);
+        header.push_back(flags);
+        if (flags) writeVarint(header, source);
+        out.write(reinterpret_cast<const char*>(header.data()), header.size());
+        bytesWritten += header.size();
+    };
+
+    auto writeBytes = [&](const unsigned char* bytes, size_t count) {
+        out.write(reinterpret_cast<const char*>(bytes), count);
+        bytesWritten += count;
+    };
+
+    auto endMember = [&]() {
+        ArchiveEntry& entry = entries.back();
+        if (!(entry.flags & HPA_MEMBER_DUPLICATE)) {
+            out.put(static_cast<char>(HPF_BLOCK_END));
+            ++bytesWritten;
+        }
+        entry.storedSize = bytesWritten - entry.offset;
+    };
+
+    auto writeOldest = [&]() {
+        std::unique_ptr<PendingBlock> block = std::move(inFlight.front());
+        inFlight.pop_front();
+        block->done.get();
+        if (result == ErrorCode::Success) result = block->result;
+        if (result == ErrorCode::Success) {
+            if (block->members > 1) {
+                // A solid group: one block per member, the first one carrying the table
+                size_t start = 0;
+                for (size_t k = 0; k < block->members; ++k) {
+                    writeMemberHeader(block->position + k);
+                    writeBytes(block->encoded.data() + start, block->ends[k] - start);
+                    entries.back().crc = block->crcs[k];
+                    endMember();
+                    start = block->ends[k];
+                    bytesDone += entries.back().size;
+                }
+            } else {
+                if (block->first) writeMemberHeader(block->position);
+                ArchiveEntry& entry = entries.back();
+                if (entry.flags & HPA_MEMBER_DUPLICATE) {
+                    entry.crc = entries[static_cast<size_t>(entry.source)].crc;
+                    bytesDone += entry.size;
+                } else if (block->copied) {
+                    writeBytes(block->encoded.data(), block->encoded.size());
+                    if (block->last) {
+                        entry.crc = block->crc;
+                        bytesDone += entry.size;
+                    }
+                } else {
+                    writeBytes(block->encoded.data(), block->encoded.size());
+
+                    // Blocks are checksummed on the workers and joined here
+                    entry.crc = crc32Combine(entry.crc, block->crc, block->size);
+                    bytesDone += block->size;
+                }
+                if (block->last) endMember();
+            }
+
+            if (options.progress && totalSize > 0) {
+                options.progress(static_cast<float>(bytesDone) / totalSize * 100.0f);
+            }
+        }
+        spare.push_back(std::move(block));
+    };
+
+    auto nextBlock = [&]() {
+        std::unique_ptr<PendingBlock> block;
+        if (spare.empty()) {
+            block = std::make_unique<PendingBlock>();
+        } else {
+            block = std::move(spare.back());
+            spare.pop_back();
+        }
+        block->members = 1;
+        block->copied = false;
+        block->encoded.clear();
+        block->crc = 0;
+        block->result = ErrorCode::Success;
+        return block;
+    };
+
+    for (size_t position = 0; position < plan.order.size() && result == ErrorCode::Success;) {
+        const size_t groupSize = plan.groupSize[position];
+
+        // Unchanged members are copied from the previous archive, a solid
+        // group only as a whole since its members need the first one's table
+        std::vector<const ArchiveEntry*> copies;
+        if (plan.flags[position] == 0) {
+            if (const ArchiveEntry* first = copyableEntry(position, nullptr)) {
+                copies.push_back(first);
+                for (size_t k = 1; k < groupSize; ++k) {
+                    const ArchiveEntry* member = copyableEntry(position + k, first);
+                    if (!member) {
+                        copies.clear();
+                        break;
+                    }
+                    copies.push_back(member);
+                }
+            }
+        }
+        if (!copies.empty() && groupSize > 1) {
+            std::unique_ptr<PendingBlock> block = nextBlock();
+            block->position = position;
+            block->members = groupSize;
+
+            PendingBlock* pending = block.get();
+            pending->done = pool.submit([pending, copies, previous]() {
+                pending->ends.clear();
+                pending->crcs.clear();
+                std::ifstream in(previous->filename, std::ios::binary);
+                for (const ArchiveEntry* entry : copies) {
+                    uint64_t from = memberDataOffset(*entry, previous->version);
+                    size_t storedBytes = static_cast<size_t>(entry->offset + entry->storedSize - from - 1);
+                    pending->result = readStoredBytes(in, from, storedBytes, true, pending->encoded);
+                    if (pending->result != ErrorCode::Success) return;
+                    pending->ends.push_back(pending->encoded.size());
+                    pending->crcs.push_back(entry->crc);
+                }
+            });
+            inFlight.push_back(std::move(block));
+            if (inFlight.size() >= maxInFlight) writeOldest();
+
+            copiedMembers += groupSize;
+            position += groupSize;
+            continue;
+        }
+        if (!copies.empty()) {
+            const ArchiveEntry* entry = copies.front();
+            const uint64_t from = memberDataOffset(*entry, previous->version);
+            const uint64_t storedBytes = entry->offset + entry->storedSize - from - 1;
+            uint64_t offset = 0;
+            do {
+                std::unique_ptr<PendingBlock> block = nextBlock();
+                block->position = position;
+                block->copied = true;
+                block->offset = from + offset;
+                block->size = static_cast<size_t>(std::min<uint64_t>(blockSize, storedBytes - offset));
+                block->first = offset == 0;
+                offset += block->size;
+                block->last = offset == storedBytes;
+                block->crc = entry->crc;
+
+                PendingBlock* pending = block.get();
+                pending->done = pool.submit([pending, previous]() {
+                    std::ifstream in(previous->filename, std::ios::binary);
+                    pending->result =
+                        readStoredBytes(in, pending->offset, pending->size, pending->last, pending->encoded);
+                });
+                inFlight.push_back(std::move(block));
+
+                if (inFlight.size() >= maxInFlight) writeOldest();
+            } while (offset < storedBytes && result == ErrorCode::Success);
+
+            ++copiedMembers;
+            ++position;
+            continue;
+        }
+
+        if (groupSize > 1) {
+            // The group is read as a whole, coded with one table from its
+            // combined counts, and every member gets a block of its own
+            std::unique_ptr<PendingBlock> block = nextBlock();
+            block->position = position;
+            block->members = groupSize;
+
+            PendingBlock* pending = block.get();
+            pending->done = pool.submit([pending, maxCodeLength, &manifest, &files, &plan]() {
+                pending->data.clear();
+                pending->ends.clear();
+                pending->crcs.clear();
+                std::vector<size_t> starts;
+                for (size_t k = 0; k < pending->members; ++k) {
+                    const ManifestEntry& file = files[plan.order[pending->position + k]];
+                    std::ifstream in(manifest.path(file), std::ios::binary);
+                    size_t start = pending->data.size();
+                    pending->data.resize(start + static_cast<size_t>(file.size));
+                    in.read(reinterpret_cast<char*>(pending->data.data() + start), file.size);
+                    if (!in || static_cast<uint64_t>(in.gcount()) != file.size) {
+                        pending->result = ErrorCode::FileReadError;
+                        return;
+                    }
+                    starts.push_back(start);
+                    pending->crcs.push_back(crc32Update(0, pending->data.data() + start, file.size));
+                }
+                starts.push_back(pending->data.size());
+
+                Histogram histogram;
+                histogram.add(pending->data.data(), pending->data.size());
+                CodeLengths lengths = CanonicalCode::buildLengths(histogram.merge(), maxCodeLength);
+                for (size_t k = 0; k < pending->members; ++k) {
+                    BlockCodec::encodeBlockWith(pending->data.data() + starts[k], starts[k + 1] - starts[k],
+                                                lengths, k == 0, true, pending->encoded);
+                    pending->ends.push_back(pending->encoded.size());
+                }
+            });
+            inFlight.push_back(std::move(block));
+            if (inFlight.size() >= maxInFlight) writeOldest();
 
+            position += groupSize;
+            continue;
+        }
+
+        const ManifestEntry& member = files[plan.order[position]];
+        // A duplicate is a single task with nothing to code
+        const uint64_t codedSize = plan.flags[position] & HPA_MEMBER_DUPLICATE ? 0 : member.size;
+        uint64_t offset = 0;
+        do {
+            std::unique_ptr<PendingBlock> block = nextBlock();
+            block->position = position;
+            block->offset = offset;
+            block->size = static_cast<size_t>(std::min<uint64_t>(blockSize, codedSize - offset));
+            block->first = offset == 0;
+            offset += block->size;
+            block->last = offset == codedSize;
+
+            PendingBlock* pending = block.get();
+            pending->done = pool.submit([pending, maxCodeLength, &manifest, &member]() {
+                if (pending->size == 0) return;
+
+                std::ifstream file(manifest.path(member), std::ios::binary);
+                pending->data.resize(pending->size);
+                file.seekg(static_cast<std::streamoff>(pending->offset));
+                file.read(reinterpret_cast<char*>(pending->data.data()), pending->size);
+                if (!file || static_cast<size_t>(file.gcount()) != pending->size) {
+                    pending->result = ErrorCode::FileReadError;
+                    return;
+                }
+                pending->crc = crc32Update(0, pending->data.data(), pending->size);
+                BlockCodec::encodeBlock(pending->data.data(), pending->size, maxCodeLength, true,
+                                        pending->encoded);
+            });
+            inFlight.push_back(std::move(block));
+
+            if (inFlight.size() >= maxInFlight) writeOldest();
+        } while (offset < codedSize && result == ErrorCode::Success);
+        ++position;
+    }
+    while (!inFlight.empty()) writeOldest();
+
+    if (result == ErrorCode::InvalidFormat && previous) {
+        if (logger) logger("Error: Archive to update is corrupted: " + previous->filename + "\n");
+        return result;
+    }
+    if (result != ErrorCode::Success) {
+        if (logger) logger("Error: Failed reading a file while archiving (changed or removed?)\n");
+        return result;
+    }
+
+    header.clear();
+    writeDirectory(entries, bytesWritten, header);
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    bytesWritten += header.size();
+
+    out.close();
+    if (!out) {
+        if (logger) logger("Error: Failed writing output file: " + outputFilename + "\n");
+        return ErrorCode::FileWriteError;
+    }
+
+    if (logger) {
+        std::stringstream ss;
+        ss << "Archived " << files.size() << " file(s), " << totalSize << " bytes -> "
+           << bytesWritten << " bytes on " << threads << " thread(s)";
+        if (plan.duplicates > 0) ss << "; " << plan.duplicates << " duplicate(s) stored once";
+        if (plan.groups > 0) ss << "; " << plan.groups << " solid group(s)";
+        if (previous) ss << "; " << copiedMembers << " unchanged file(s) copied";
+        ss << "\n";
+        logger(ss.str());
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode Archiver::compressDirectory(const std::string& directoryPath, const std::string& outputFilename,
+                                      const ArchiveOptions& options) {
+    Manifest manifest;
+    ErrorCode scanned = scanDirectory(directoryPath, options, manifest);
+    if (scanned != ErrorCode::Success) return scanned;
+    return compressDirectory(manifest, outputFilename, options);
+}
+
+ErrorCode Archiver::compressDirectory(const Manifest& manifest, const std::string& outputFilename,
+                                      const ArchiveOptions& options) {
+    return writeArchive(manifest, outputFilename, options, nullptr);
+}
+
+ErrorCode Archiver::updateArchive(const std::string& directoryPath, const std::string& archiveFilename,
+                                  const ArchiveOptions& options) {
+    const LogCallback& logger = options.logger;
+
+    PreviousArchive previous;
+    previous.filename = archiveFilename;
+    {
+        std::ifstream in(archiveFilename, std::ios::binary);
+        if (!in.is_open()) {
+            // Nothing to update yet
+            return compressDirectory(directoryPath, archiveFilename, options);
+        }
+        if (!readDirectory(in, previous.entries, previous.version)) {
+            if (logger) logger("Error: Cannot update, no central directory: " + archiveFilename + "\n");
+            return ErrorCode::InvalidFormat;
+        }
+    }
+    if (previous.version < 3 && logger) {
+        logger("Archive records no modification times; every file is compressed again\n");
+    }
+
+    Manifest manifest;
+    ErrorCode scanned = scanDirectory(directoryPath, options, manifest);
+    if (scanned != ErrorCode::Success) return scanned;
+    const std::vector<ManifestEntry>& files = manifest.entries();
+
+    // A file is unchanged if the archive has it with the same size and time
+    std::unordered_map<std::string_view, size_t> byName;
+    for (size_t i = 0; i < previous.entries.size(); ++i) {
+        byName.emplace(previous.entries[i].name, i);
+    }
+    previous.unchanged.assign(files.size(), SIZE_MAX);
+    for (size_t i = 0; i < files.size() && previous.version >= 3; ++i) {
+        auto found = byName.find(manifest.name(files[i]));
+        if (found == byName.end()) continue;
+        const ArchiveEntry& entry = previous.entries[found->second];
+        if (entry.size == files[i].size && entry.modified == files[i].modified) previous.unchanged[i] = found->second;
+    }
+
+    if (options.verifyContents) {
+        // and, when asked, the same checksum
+        ThreadPool pool(options.threads);
+        std::vector<std::future<void>> tasks;
+        for (size_t i = 0; i < files.size(); ++i) {
+            if (previous.unchanged[i] == SIZE_MAX) continue;
+            tasks.push_back(pool.submit([&, i]() {
+                uint32_t crc;
+                if (!checksumFile(manifest.path(files[i]), crc) || crc != previous.entries[previous.unchanged[i]].crc) {
+                    previous.unchanged[i] = SIZE_MAX;
+                }
+            }));
+        }
+        for (std::future<void>& task : tasks) {
+            task.get();
+        }
+    }
+
+    // The old archive is read until the new one is complete, then replaced
+    const std::string updatedFilename = archiveFilename + ".update";
+    ErrorCode result = writeArchive(manifest, updatedFilename, options, &previous);
+    std::error_code error;
+    if (result == ErrorCode::Success) {
+        fs::rename(updatedFilename, archiveFilename, error);
+        if (!error) return ErrorCode::Success;
+        if (logger) logger("Error: Cannot replace " + archiveFilename + ": " + error.message() + "\n");
+        result = ErrorCode::FileWriteError;
+    }
+    fs::remove(updatedFilename, error);
+    return result;
+}
+
+// The fields in front of a member's data
+struct MemberHeader {
+    std::string name;
+    uint64_t size = 0;
+    unsigned char flags = 0;
+    uint64_t source = 0;  // For duplicates and solid members: index of the member referred to
+};
+
+// Reads the path and original size in front of a member's blocks and, from
+// version 2 on, its flags and the member it refers to
+static ErrorCode readMemberHeader(BitReader& reader, int version, MemberHeader& member) {
+    uint64_t nameLength;
+    if (!readVarint(reader, nameLength) || nameLength > MAX_PATH_LENGTH) return ErrorCode::InvalidFormat;
+    member.name.resize(static_cast<size_t>(nameLength));
+    if (!reader.readBytes(reinterpret_cast<unsigned char*>(member.name.data()), member.name.size()) ||
+        !readVarint(reader, member.size)) {
+        return ErrorCode::FileReadError;
+    }
+    if (!isSafeMemberPath(member.name)) return ErrorCode::InvalidFormat;
+
+    member.flags = 0;
+    member.source = 0;
+    if (version >= 2) {
+        if (!reader.readByte(member.flags)) return ErrorCode::FileReadError;
+        if ((member.flags & ~(HPA_MEMBER_DUPLICATE | HPA_MEMBER_SOLID)) ||
+            member.flags == (HPA_MEMBER_DUPLICATE | HPA_MEMBER_SOLID)) {
+            return ErrorCode::InvalidFormat;
+        }
+        if (member.flags && !readVarint(reader, member.source)) return ErrorCode::FileReadError;
+    }
+    return ErrorCode::Success;
+}
+
+// Materializes a duplicate from its already extracted first copy. The copy is
+// left to the filesystem, which can do it without passing the data through here.
+static ErrorCode copyExtracted(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+    return ec ? ErrorCode::FileCreateError : ErrorCode::Success;
+}
+
+// Decodes the blocks of one member, up to its end marker
+struct MemberDecoder {
+    DecodeTable table;
+    std::vector<unsigned char> scratch;
+    std::vector<unsigned char> block;
+    uint64_t blocks = 0;  // Blocks in the last member decoded
+
+    // Writes the member's `size` bytes to `out`; `crc` receives their CRC-32.
+    // A member starts with its own table, except that the members of a solid
+    // group (`shared`) are coded with the group's table, which must already be
+    // in `table`, and never replace it.
+    ErrorCode decode(BitReader& reader, uint64_t size, std::ostream& out, uint32_t& crc, bool shared = false) {
+        bool haveTable = shared;
+        uint64_t written = 0;
+        crc = 0;
+        blocks = 0;
+        while (true) {
+            BlockHeader header;
+            if (!BlockCodec::readHeader(reader, header)) return ErrorCode::InvalidFormat;
+            if (header.flags == HPF_BLOCK_END) break;
+            if ((header.flags & HPF_BLOCK_REUSE_TABLE) ? !haveTable : shared) return ErrorCode::InvalidFormat;
+            if (header.rawSize > size - written) return ErrorCode::InvalidFormat;
+
+            const unsigned char* body;
+            if (!reader.readSpan(body, static_cast<size_t>(header.bodySize), scratch)) {
+                return ErrorCode::FileReadError;
+            }
+            block.resize(static_cast<size_t>(header.rawSize));
+            if (!BlockCodec::decodeBody(header, body, block.data(), table)) return ErrorCode::DecompressionFailed;
+            haveTable = true;
+            ++blocks;
+
+            crc = crc32Update(crc, block.data(), block.size());
+            out.write(reinterpret_cast<const char*>(block.data()), block.size());
+            written += header.rawSize;
+        }
+        if (written != size) return ErrorCode::InvalidFormat;
+        return out ? ErrorCode::Success : ErrorCode::FileWriteError;
+    }
+};
+
+// Reads the magic, version and member count at the start of a native archive
+static bool readArchiveHeader(BitReader& reader, int& version, uint64_t& memberCount) {
+    unsigned char magic[sizeof(HPA_MAGIC) + 1];
+    if (!reader.readBytes(magic, sizeof(magic)) || !std::equal(std::begin(HPA_MAGIC), std::end(HPA_MAGIC), magic)) {
+        return false;
+    }
+    version = magic[sizeof(HPA_MAGIC)];
+    return version >= HPA_VERSION_FIRST && version <= HPA_VERSION && readVarint(reader, memberCount);
+}
+
+// Extracts the member `entry` describes, with `reader` positioned at its start,
+// to `outputPath` and checks it against the entry. The member must hold its
+// own data, not be a duplicate; for a solid member the decoder must hold the
+// table of its group.
+static ErrorCode extractEntry(BitReader& reader, int version, const ArchiveEntry& entry, const fs::path& outputPath,
+                              MemberDecoder& decoder) {
+    MemberHeader member;
+    ErrorCode result = readMemberHeader(reader, version, member);
+    if (result != ErrorCode::Success) return result;
+    if (member.name != entry.name || member.size != entry.size || member.flags != entry.flags ||
+        member.source != entry.source || (entry.flags & HPA_MEMBER_DUPLICATE)) {
+        return ErrorCode::InvalidFormat;
+    }
+
+    std::ofstream out(outputPath, std::ios::binary);
+    if (!out.is_open()) return ErrorCode::FileCreateError;
+
+    uint32_t crc;
+    result = decoder.decode(reader, member.size, out, crc, entry.flags & HPA_MEMBER_SOLID);
+    if (result == ErrorCode::Success && crc != entry.crc) result = ErrorCode::ChecksumMismatch;
+    return result;
+}
+
+// Loads the table of a solid group into the decoder from the group's first
+// member (`first`, with `reader` positioned at its start), whose single block
+// carries it, without decoding the member
+static ErrorCode loadGroupTable(BitReader& reader, int version, const ArchiveEntry& first, MemberDecoder& decoder) {
+    MemberHeader member;
+    ErrorCode result = readMemberHeader(reader, version, member);
+    if (result != ErrorCode::Success) return result;
+
+    BlockHeader header;
+    const unsigned char* body;
+    if (member.name != first.name || member.flags != 0 || !BlockCodec::readHeader(reader, header) ||
+        header.flags == HPF_BLOCK_END || (header.flags & HPF_BLOCK_REUSE_TABLE) || header.rawSize != member.size) {
+        return ErrorCode::InvalidFormat;
+    }
+    if (!reader.readSpan(body, static_cast<size_t>(header.bodySize), decoder.scratch)) return ErrorCode::FileReadError;
+    return BlockCodec::loadTable(header, body, decoder.table) ? ErrorCode::Success : ErrorCode::DecompressionFailed;
+}
+
+// Extracts members side by side through the central directory: every worker
+// takes the next member in directory order, or a whole solid group, and
+// decodes it from its offset, straight from the mapping when the archive is
+// mapped. Directories are created up front, once each, and each file is
+// written by a single worker, so the output is the same for any thread count.
+// Duplicates are copied once all files with data are written.
+static ErrorCode extractNativeArchiveParallel(InputSource& in, const std::string& archiveFilename,
+                                              const std::string& outputDirectory,
+                                              const std::vector<ArchiveEntry>& entries, unsigned threads,
+                                              const ArchiveOptions& options) {
+    BitReader headerReader(in);
+    int version;
+    uint64_t memberCount;
+    if (!readArchiveHeader(headerReader, version, memberCount) || entries.size() != memberCount) {
+        return ErrorCode::InvalidFormat;
+    }
+
+    std::vector<fs::path> directories;
+    directories.reserve(entries.size());
+    for (const ArchiveEntry& entry : entries) {
+        if (!isSafeMemberPath(entry.name)) return ErrorCode::InvalidFormat;
+        directories.push_back((fs::path(outputDirectory) / fs::path(entry.name)).parent_path());
+    }
+    std::sort(directories.begin(), directories.end());
+    directories.erase(std::unique(directories.begin(), directories.end()), directories.end());
+    for (const fs::path& directory : directories) {
+        std::error_code ignored;  // A directory that could not be made fails its files' creation
+        fs::create_directories(directory, ignored);
+    }
+
+    // Units of work: a member with data followed by the solid members sharing
+    // its table, then every duplicate on its own
+    std::vector<size_t> order;
+    order.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (!(entries[i].flags & HPA_MEMBER_DUPLICATE)) order.push_back(i);
+    }
+    auto unitOf = [&](size_t i) {
+        return (entries[i].flags & HPA_MEMBER_SOLID) ? static_cast<size_t>(entries[i].source) : i;
+    };
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return unitOf(a) < unitOf(b); });
+
+    std::vector<size_t> unitStarts;
+    for (size_t k = 0; k < order.size(); ++k) {
+        if (k == 0 || unitOf(order[k]) != unitOf(order[k - 1])) unitStarts.push_back(k);
+    }
+    const size_t unitsWithData = unitStarts.size();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].flags & HPA_MEMBER_DUPLICATE) {
+            unitStarts.push_back(order.size());
+            order.push_back(i);
+        }
+    }
+    unitStarts.push_back(order.size());
+
+    const unsigned char* mapped = in.isMapped() ? in.data() : nullptr;
+    std::vector<ErrorCode> results(entries.size(), ErrorCode::Success);
+    std::atomic<size_t> nextUnit{0};
+    std::atomic<size_t> membersDone{0};
+    std::atomic<bool> failed{false};
+    size_t phaseEnd = 0;
+
+    auto work = [&]() {
+        MemberDecoder decoder;
+        std::ifstream file;
+        if (!mapped) file.open(archiveFilename, std::ios::binary);
+
+        while (!failed) {
+            size_t unit = nextUnit++;
+            if (unit >= phaseEnd) break;
+
+            bool haveGroupTable = false;
+            for (size_t k = unitStarts[unit]; k < unitStarts[unit + 1]; ++k) {
+                size_t i = order[k];
+                const ArchiveEntry& entry = entries[i];
+                fs::path outPath = fs::path(outputDirectory) / fs::path(entry.name);
+                if (entry.flags & HPA_MEMBER_DUPLICATE) {
+                    const ArchiveEntry& source = entries[static_cast<size_t>(entry.source)];
+                    results[i] = copyExtracted(fs::path(outputDirectory) / fs::path(source.name), outPath);
+                } else if ((entry.flags & HPA_MEMBER_SOLID) && !haveGroupTable) {
+                    // The group's first member did not leave its table behind
+                    results[i] = ErrorCode::InvalidFormat;
+                } else if (mapped) {
+                    BitReader reader(mapped + entry.offset, static_cast<size_t>(entry.storedSize));
+                    results[i] = extractEntry(reader, version, entry, outPath, decoder);
+                } else {
+                    file.clear();
+                    file.seekg(static_cast<std::streamoff>(entry.offset));
+                    BitReader reader(file);
+                    results[i] = extractEntry(reader, version, entry, outPath, decoder);
+                }
+                if (entry.flags == 0) haveGroupTable = results[i] == ErrorCode::Success && decoder.blocks == 1;
+                if (results[i] != ErrorCode::Success) failed = true;
+                ++membersDone;
+            }
+        }
+    };
+
+    ThreadPool pool(threads);
+    for (auto [begin, end] : {std::pair(size_t(0), unitsWithData), std::pair(unitsWithData, unitStarts.size() - 1)}) {
+        nextUnit = begin;
+        phaseEnd = end;
+        std::vector<std::future<void>> workers;
+        for (unsigned t = 0; t < pool.size(); ++t) {
+            workers.push_back(pool.submit(work));
+        }
+
+        // Progress is reported from this thread as members complete
+        for (std::future<void>& worker : workers) {
+            while (worker.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready) {
+                if (options.progress) options.progress(static_cast<float>(membersDone) / entries.size() * 100.0f);
+            }
+            worker.get();
+        }
+    }
+
+    // The first failing member in archive order decides the result
+    for (ErrorCode result : results) {
+        if (result != ErrorCode::Success) return result;
+    }
+    if (options.progress) options.progress(100.0f);
+    return ErrorCode::Success;
+}
+
+// Extracts every member front to back. With a central directory (`entries`
+// not empty), each member is checked against its entry and checksum.
+static ErrorCode extractNativeArchive(InputSource& in, const std::string& outputDirectory,
+                                      const std::vector<ArchiveEntry>& entries, const ArchiveOptions& options) {
+    BitReader reader(in);
+
+    int version;
+    uint64_t memberCount;
+    if (!readArchiveHeader(reader, version, memberCount)) return ErrorCode::InvalidFormat;
+    if (!entries.empty() && entries.size() != memberCount) return ErrorCode::InvalidFormat;
+
+    MemberDecoder decoder;
+    MemberHeader member;
+    std::vector<MemberHeader> extracted;  // Earlier members, for duplicates to copy from
+    uint64_t tableFrom = UINT64_MAX;      // Member whose single block left its table in the decoder
+
+    for (uint64_t i = 0; i < memberCount; ++i) {
+        ErrorCode result = readMemberHeader(reader, version, member);
+        if (result != ErrorCode::Success) return result;
+
+        const ArchiveEntry* entry = entries.empty() ? nullptr : &entries[static_cast<size_t>(i)];
+        if (entry && (entry->name != member.name || entry->size != member.size || entry->flags != member.flags ||
+                      entry->source != member.source)) {
+            return ErrorCode::InvalidFormat;
+        }
+
+        fs::path outPath = fs::path(outputDirectory) / fs::path(member.name);
+        fs::create_directories(outPath.parent_path());
+
+        if (member.flags & HPA_MEMBER_DUPLICATE) {
+            if (member.source >= i) return ErrorCode::InvalidFormat;
+            const MemberHeader& source = extracted[static_cast<size_t>(member.source)];
+            if ((source.flags & HPA_MEMBER_DUPLICATE) || source.size != member.size) return ErrorCode::InvalidFormat;
+            result = copyExtracted(fs::path(outputDirectory) / fs::path(source.name), outPath);
+            if (result != ErrorCode::Success) return result;
+        } else {
+            // Solid members follow the first member of their group
+            bool shared = member.flags & HPA_MEMBER_SOLID;
+            if (shared && member.source != tableFrom) return ErrorCode::InvalidFormat;
+
+            std::ofstream outFile(outPath, std::ios::binary);
+            if (!outFile.is_open()) return ErrorCode::FileCreateError;
+
+            uint32_t crc;
+            result = decoder.decode(reader, member.size, outFile, crc, shared);
+            if (result != ErrorCode::Success) return result;
+            if (entry && entry->crc != crc) return ErrorCode::ChecksumMismatch;
+            if (!shared) tableFrom = decoder.blocks == 1 ? i : UINT64_MAX;
+        }
+        extracted.push_back(member);
+
+        if (options.progress && memberCount > 0) {
+            options.progress(static_cast<float>(i + 1) / memberCount * 100.0f);
+        }
+    }
+    return ErrorCode::Success;
+}
+
+bool Archiver::isNativeArchive(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    unsigned char magic[sizeof(HPA_MAGIC)] = {};
+    in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    return in && std::equal(std::begin(HPA_MAGIC), std::end(HPA_MAGIC), magic);
+}
+
+// True if the file is an uncompressed bundle, as archiveDirectory writes them
+static bool isBundle(std::istream& in) {
+    char magic[sizeof(LEGACY_ARCHIVE_MAGIC)] = {};
+    in.read(magic, sizeof(magic));
+    return in && std::equal(std::begin(LEGACY_ARCHIVE_MAGIC), std::end(LEGACY_ARCHIVE_MAGIC), magic);
+}
+
+static bool isBundle(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    return isBundle(in);
+}
+
+bool Archiver::isLegacyArchive(const std::string& filename) {
+    if (isBundle(filename)) return true;
+
+    // Only the start of a compressed file is decoded: the pipe holds a single
+    // small chunk, and the decoder stops once the check hangs up
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) return false;
+    BytePipe pipe(64 * 1024, 1);
+    ThreadPool pool(1);
+    std::future<void> decoding = pool.submit([&]() {
+        std::ostream decoded(pipe.output());
+        Decompressor decompressor;
+        try {
+            decompressor.decompress(file, decoded);
+        } catch (...) {
+        }
+        pipe.closeWrite();
+    });
+
+    std::istream decoded(pipe.input());
+    bool bundle = isBundle(decoded);
+    pipe.closeRead();
+    decoding.get();
+    return bundle;
+}
+
+ErrorCode Archiver::extractArchive(const std::string& archiveFilename, const std::string& outputDirectory,
+                                   const ArchiveOptions& options) {
+    bool native = isNativeArchive(archiveFilename);
+
+    // With a central directory members can be extracted side by side;
+    // without one they are read front to back
+    std::vector<ArchiveEntry> entries;
+    if (native) {
+        std::ifstream file(archiveFilename, std::ios::binary);
+        int version;
+        readDirectory(file, entries, version);
+    }
+    const unsigned threads = options.threads > 0 ? options.threads : ThreadPool::hardwareThreads();
+    bool parallel = threads > 1 && entries.size() > 1;
+
+    InputSource in;
+    if (in.open(archiveFilename, parallel ? InputSource::Access::Random : InputSource::Access::Sequential) !=
+        ErrorCode::Success) {
+        return ErrorCode::FileNotFound;
+    }
+
+    fs::create_directories(outputDirectory);
+
+    ErrorCode result;
+    if (!native && !isBundle(archiveFilename)) {
+        result = extractCompressedBundle(archiveFilename, outputDirectory);
+    } else if (!native) {
+        result = extractLegacyArchive(in, outputDirectory);
+    } else if (parallel) {
+        result = extractNativeArchiveParallel(in, archiveFilename, outputDirectory, entries, threads, options);
+    } else {
+        result = extractNativeArchive(in, outputDirectory, entries, options);
+    }
+    if (result != ErrorCode::Success && options.logger) {
+        options.logger("Error: Failed extracting " + archiveFilename + ": " + getErrorMessage(result) + "\n");
+    }
+    return result;
+}
+
+ErrorCode Archiver::listArchive(const std::string& archiveFilename, std::vector<ArchiveEntry>& entries) {
+    entries.clear();
+    std::ifstream in(archiveFilename, std::ios::binary);
+    if (!in.is_open()) return ErrorCode::FileNotFound;
+
+    int version;
+    return readDirectory(in, entries, version) ? ErrorCode::Success : ErrorCode::InvalidFormat;
+}
+
+ErrorCode Archiver::extractMember(const std::string& archiveFilename, const std::string& memberName,
+                                  const std::string& outputFilename, const ArchiveOptions& options) {
+    const LogCallback& logger = options.logger;
+
+    std::ifstream in(archiveFilename, std::ios::binary);
+    if (!in.is_open()) {
+        if (logger) logger("Error: Cannot open " + archiveFilename + "\n");
+        return ErrorCode::FileNotFound;
+    }
+
+    std::vector<ArchiveEntry> entries;
+    int version;
+    if (!readDirectory(in, entries, version)) {
+        if (logger) logger("Error: No central directory in " + archiveFilename + "\n");
+        return ErrorCode::InvalidFormat;
+    }
+
+    auto entry = std::find_if(entries.begin(), entries.end(),
+                              [&](const ArchiveEntry& candidate) { return candidate.name == memberName; });
+    if (entry == entries.end()) {
+        if (logger) logger("Error: No member named " + memberName + " in " + archiveFilename + "\n");
+        return ErrorCode::FileNotFound;
+    }
+
+    // A duplicate is extracted from its first copy, and a solid member after
+    // loading its group's table. Reading starts at the member holding the
+    // data; the reader stops at its end marker.
+    const ArchiveEntry& data =
+        (entry->flags & HPA_MEMBER_DUPLICATE) ? entries[static_cast<size_t>(entry->source)] : *entry;
+    MemberDecoder decoder;
+    ErrorCode result = ErrorCode::Success;
+    if (data.flags & HPA_MEMBER_SOLID) {
+        const ArchiveEntry& first = entries[static_cast<size_t>(data.source)];
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(first.offset));
+        BitReader reader(in);
+        result = loadGroupTable(reader, version, first, decoder);
+    }
+    if (result == ErrorCode::Success) {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(data.offset));
+        BitReader reader(in);
+        result = extractEntry(reader, version, data, outputFilename, decoder);
+    }
+    if (result != ErrorCode::Success) {
+        if (logger) logger("Error: Failed extracting " + memberName + ": " + getErrorMessage(result) + "\n");
+        return result;
+    }
+    if (options.progress) options.progress(100.0f);
+    if (logger) {
+        std::stringstream ss;
+        ss << "Extracted " << memberName << ": " << data.storedSize << " bytes -> " << data.size << " bytes\n";
+        logger(ss.str());
+    }
     return ErrorCode::Success;
 }
@@ -1,5 +1,7 @@
 #include "bitReader.h"
 #include <iostream> // For debug output
+#include <cstring>  // For std::memmove, std::memcpy
+#include <algorithm>
 #include "config.h"
 
 static const size_t BUFFER_CAPACITY = 64 * 1024; // 64KB
@@ -7,67 +9,92 @@ static const size_t BUFFER_CAPACITY = 64 * 1024; // 64KB
 // Constructor: binds the BitReader to an input stream.
 // Also initializes buffer and bit counter.
 BitReader::BitReader(std::istream& in)
-    : inputStream(in), currentByte(0), bitsRemaining(0),
-      fileBuffer(BUFFER_CAPACITY), bufferIndex(0), bufferSize(0) {}
+    : inputStream(&in), bitBuffer(0), bitCount(0), fileBuffer(BUFFER_CAPACITY) {
+    cursor = end = fileBuffer.data();
+}
+
+// Memory mode: the whole input is already in [data, data + size)
+BitReader::BitReader(const unsigned char* data, size_t size)
+    : inputStream(nullptr), bitBuffer(0), bitCount(0), cursor(data), end(data + size) {}
+
+BitReader::BitReader(InputSource& source)
+    : inputStream(nullptr), bitBuffer(0), bitCount(0) {
+    if (source.isMapped()) {
+        cursor = source.data();
+        end = cursor + source.size();
+    } else {
+        inputStream = &source.stream();
+        fileBuffer.resize(BUFFER_CAPACITY);
+        cursor = end = fileBuffer.data();
+    }
+}
 
+// Moves the unread tail to the front of the buffer and reads the next block behind it,
+// so a whole word can always be loaded from contiguous memory.
+// Returns true if any new bytes were read.
 bool BitReader::refillBuffer() {
-    if (!inputStream) return false;
-    inputStream.read(fileBuffer.data(), BUFFER_CAPACITY);
-    bufferSize = inputStream.gcount();
-    bufferIndex = 0;
-    return bufferSize > 0;
+    if (!inputStream || !*inputStream) return false;
+
+    size_t leftover = end - cursor;
+    std::memmove(fileBuffer.data(), cursor, leftover);
+    cursor = fileBuffer.data();
+
+    inputStream->read(reinterpret_cast<char*>(fileBuffer.data() + leftover), BUFFER_CAPACITY - leftover);
+    size_t bytesRead = static_cast<size_t>(inputStream->gcount());
+    end = cursor + leftover + bytesRead;
+    return bytesRead > 0;
 }
 
-// Reads a single bit from the input stream.
-// If no bits are left in the buffer, it reads a new byte into the buffer.
-bool BitReader::readBit(bool& bit) {
-    // Refill buffer if all bits are consumed
-    if (bitsRemaining == 0) {
-        if (bufferIndex >= bufferSize) {
-            if (!refillBuffer()) {
-#if ENABLE_LOGGING
-                std::cerr << "End of stream or error while reading a byte.\n";
-#endif
-                return false;
-            }
-        }
+// Fewer than 8 bytes buffered: pull in the next block of the stream, then load
+// a whole word if that helped, or byte by byte so nothing past the end is touched.
+void BitReader::refillSlow() {
+    if (refillBuffer() && end - cursor >= 8) {
+        refill();
+        return;
+    }
 
-        currentByte = static_cast<unsigned char>(fileBuffer[bufferIndex++]);
-        bitsRemaining = 8;
+    while (bitCount <= 56 && cursor < end) {
+        bitBuffer |= static_cast<uint64_t>(*cursor++) << (56 - bitCount);
+        bitCount += 8;
+    }
 
 #if ENABLE_LOGGING
-        std::cout << "Loaded byte into buffer: "
-                  << std::hex << static_cast<int>(currentByte)
-                  << " (" << std::dec << static_cast<int>(currentByte) << ")\n";
+    if (bitCount == 0) std::cerr << "End of stream or error while reading a byte.\n";
 #endif
-    }
+}
+
+bool BitReader::readBits(int count, uint32_t& value) {
+    int available;
+    value = peekBits(count, available);
+    if (available < count) return false;
+    consumeBits(count);
+    return true;
+}
 
-    // Extract the next bit from the buffer (MSB to LSB)
-    bit = (currentByte >> (bitsRemaining - 1)) & 1;
-    bitsRemaining--;
+// Reads a single bit from the input stream.
+bool BitReader::readBit(bool& bit) {
+    uint32_t value;
+    if (!readBits(1, value)) return false;
+    bit = value != 0;
 
 #if ENABLE_LOGGING
     std::cout << "Bit Read: " << bit
-              << " | Bits Remaining: " << bitsRemaining << "\n";
+              << " | Bits Remaining: " << bitCount << "\n";
 #endif
 
     return true;
 }
 
-// Reads a full byte (8 bits) by calling readBit() 8 times.
-// Assembles bits from MSB to LSB into a single byte.
+// Reads a full byte (8 bits), MSB first.
 bool BitReader::readByte(unsigned char& byte) {
-    byte = 0;
-    for (int i = 0; i < 8; ++i) {
-        bool bit;
-        if (!readBit(bit)) {
+    uint32_t value;
+    if (!readBits(8, value)) {
 #if ENABLE_LOGGING
-            std::cerr << "Failed to read bit while constructing byte.\n";
+        std::cerr << "Failed to read bits while constructing byte.\n";
 #endif
-            return false;
-        }
-        byte = (byte << 1) | bit;
+        return false;
     }
+    byte = static_cast<unsigned char>(value);
 
 #if ENABLE_LOGGING
     std::cout << "Full Byte Read: "
@@ -78,13 +105,57 @@ bool BitReader::readByte(unsigned char& byte) {
     return true;
 }
 
+// Drains the whole bytes already in bitBuffer, then copies straight from the buffer.
+bool BitReader::readBytes(unsigned char* dest, size_t count) {
+    while (count > 0 && bitCount >= 8) {
+        *dest++ = static_cast<unsigned char>(bitBuffer >> 56);
+        consumeBits(8);
+        --count;
+    }
+    if (count == 0) return true;
+
+    // bitBuffer may still hold look-ahead copies of the bytes at cursor; they go stale
+    // once the bytes are copied out directly
+    bitBuffer = 0;
+    bitCount = 0;
+
+    while (count > 0) {
+        if (cursor == end && !refillBuffer()) return false;
+        size_t chunk = std::min(count, static_cast<size_t>(end - cursor));
+        std::memcpy(dest, cursor, chunk);
+        dest += chunk;
+        cursor += chunk;
+        count -= chunk;
+    }
+    return true;
+}
+
+bool BitReader::readSpan(const unsigned char*& span, size_t count, std::vector<unsigned char>& scratch) {
+    if (inputStream) {
+        scratch.resize(count);
+        span = scratch.data();
+        return readBytes(scratch.data(), count);
+    }
+
+    // Whole bytes still in bitBuffer are look-ahead copies of the ones before cursor
+    const unsigned char* position = bytePosition();
+    if (static_cast<size_t>(end - position) < count) return false;
+    span = position;
+    cursor = position + count;
+    bitBuffer = 0;
+    bitCount = 0;
+    return true;
+}
+
 // Skips remaining bits in the current buffer and aligns to the next full byte.
+// Only whole bytes are ever loaded, so the partial byte is the bitCount % 8 leading bits.
 void BitReader::alignToByte() {
-    if (bitsRemaining > 0) {
+    int leftover = bitCount % 8;
+    if (leftover > 0) {
 #if ENABLE_LOGGING
         std::cout << "Aligning to byte boundary. Discarding "
-                  << bitsRemaining << " remaining bits.\n";
+                  << leftover << " remaining bits.\n";
 #endif
-        bitsRemaining = 0;
+        consumeBits(leftover);
     }
 }
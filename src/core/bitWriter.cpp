@@ -4,34 +4,31 @@
 
 #include <iostream>
 #include <string>
-#include <bitset>  // Needed for std::bitset
 
 
+static const size_t BUFFER_CAPACITY = 64 * 1024; // 64KB
+
 // Constructor binds the writer to an output stream
-BitWriter::BitWriter(std::ostream& outputStream) : out(outputStream) {}
+BitWriter::BitWriter(std::ostream& outputStream)
+    : out(&outputStream), byteBuffer(BUFFER_CAPACITY) {}
+
+BitWriter::BitWriter(std::vector<unsigned char>& memory)
+    : sink(&memory), byteBuffer(BUFFER_CAPACITY) {}
 
 // Destructor ensures that any remaining bits in the buffer are flushed
 BitWriter::~BitWriter() {
     flush();
 }
 
-// Writes a single bit into the buffer. When 8 bits are collected, writes a byte to the stream.
+// Writes a single bit into the accumulator
 void BitWriter::writeBit(bool bit) {
-    buffer = (buffer << 1) | bit;  // Shift buffer and insert new bit
-    bitCount++;
+    writeBits(bit ? 1u : 0u, 1);
 
 #if ENABLE_LOGGING
     std::cout << "Bit Written: " << bit
-              << " | Buffer: " << std::bitset<8>(static_cast<int>(buffer))
-              << " | Bit Count: " << bitCount << "\n";
+              << " | Pending: " << bitCount << " bits"
+              << " | Buffered: " << byteCount << " bytes\n";
 #endif
-
-    // Write byte when buffer is full
-    if (bitCount == 8) {
-        out.put(buffer);
-        buffer = 0;
-        bitCount = 0;
-    }
 }
 
 // Writes a string of '0' and '1' characters to the stream as actual bits
@@ -42,27 +39,36 @@ void BitWriter::writeBits(const std::string& bits) {
 }
 
 // Writes a raw byte directly (used for writing file size, etc.)
-// Writes a raw byte by writing 8 bits (MSB first)
+// Writes a raw byte as 8 bits (MSB first)
 void BitWriter::writeByte(unsigned char byte) {
-    for (int i = 7; i >= 0; --i) {
-        writeBit((byte >> i) & 1);
+    writeBits(byte, 8);
+}
+
+void BitWriter::drainBuffer() {
+    if (out) {
+        out->write(reinterpret_cast<const char*>(byteBuffer.data()), byteCount);
+    } else {
+        sink->insert(sink->end(), byteBuffer.begin(), byteBuffer.begin() + byteCount);
     }
+    byteCount = 0;
 }
 
-// Flushes any bits left in the buffer by padding with 0s and writing the final byte
+// Flushes any pending bits by padding with 0s to a whole byte, then writes the buffer out
 void BitWriter::flush() {
-    if (bitCount > 0) {
-        buffer <<= (8 - bitCount);  // Pad remaining bits with 0s
+    if (bitCount % 8 != 0) {
+        writeBits(0, 8 - bitCount % 8);  // Pad remaining bits with 0s
+    }
+
+    while (bitCount > 0) {
+        bitCount -= 8;
+        byteBuffer[byteCount++] = static_cast<unsigned char>(bitBuffer >> bitCount);
+    }
 
 #if ENABLE_LOGGING
-        std::cout << "Flushing incomplete byte: " << std::bitset<8>(static_cast<int>(buffer))
-                  << " (" << static_cast<int>(buffer) << ")\n";
+    std::cout << "Flushing " << byteCount << " buffered bytes\n";
 #endif
 
-        out.put(buffer);
-        buffer = 0;
-        bitCount = 0;
-    }
+    if (byteCount > 0) drainBuffer();
 }
 
 // Begins serialization of the Huffman tree
@@ -0,0 +1,288 @@
+#include "blockCodec.h"
+#include "bitWriter.h"
+#include "histogram.h"
+#include "hpfFormat.h"
+
+#include <algorithm>
+
+// True if every byte that occurs in the block has a code under `lengths`
+static bool coversBlock(const FrequencyTable& frequencies, const CodeLengths& lengths) {
+    for (int byte = 0; byte < 256; ++byte) {
+        if (frequencies[byte] > 0 && lengths[byte] == 0) return false;
+    }
+    return true;
+}
+
+static const int STREAMS = DecodeTable::INTERLEAVED_STREAMS;
+
+// Symbols per interleaved stream: consecutive quarters, the last one possibly shorter
+static void splitStreams(size_t size, size_t (&counts)[STREAMS]) {
+    size_t quarter = (size + STREAMS - 1) / STREAMS;
+    for (int s = 0; s < STREAMS; ++s) {
+        size_t start = std::min(size, quarter * s);
+        counts[s] = std::min(quarter, size - start);
+    }
+}
+
+static void encodeSymbols(const unsigned char* data, size_t size, const CodeTable& table, BitWriter& writer) {
+    for (size_t i = 0; i < size; ++i) {
+        const HuffmanCode& code = table[data[i]];
+        writer.writeBits(code.bits, code.length);
+    }
+}
+
+void BlockCodec::encodeBlock(const unsigned char* data, size_t size, int maxCodeLength, bool interleaved,
+                             std::vector<unsigned char>& out, CodeLengths* previous,
+                             BlockStats* stats) {
+    Histogram histogram;
+    histogram.add(data, size);
+    FrequencyTable frequencies = histogram.merge();
+
+    CodeLengths lengths = CanonicalCode::buildLengths(frequencies, maxCodeLength);
+
+    // The new table's size in bits, rounded up to whole bytes
+    std::vector<unsigned char> lengthTable;
+    {
+        BitWriter writer(lengthTable);
+        CanonicalCode::writeLengths(writer, lengths);
+    }
+
+    // Reuse the previous table when coding with it costs no more than storing this one
+    bool reuse = false;
+    if (previous && coversBlock(frequencies, *previous)) {
+        uint64_t freshBits = lengthTable.size() * 8 + CanonicalCode::encodedBits(frequencies, lengths);
+        uint64_t reusedBits = CanonicalCode::encodedBits(frequencies, *previous);
+        if (reusedBits <= freshBits) {
+            lengths = *previous;
+            reuse = true;
+        }
+    }
+    if (previous) *previous = lengths;
+
+    if (stats) {
+        CodeLengths unlimited = CanonicalCode::buildLengths(frequencies, CanonicalCode::MAX_CODE_LENGTH);
+        stats->payloadBits = CanonicalCode::encodedBits(frequencies, lengths);
+        stats->unlimitedBits = CanonicalCode::encodedBits(frequencies, unlimited);
+        stats->longestCode = *std::max_element(lengths.begin(), lengths.end());
+        stats->longestUnlimited = *std::max_element(unlimited.begin(), unlimited.end());
+        stats->reusedTable = reuse;
+    }
+
+    encodeBlockWith(data, size, lengths, !reuse, interleaved, out);  // Lengths from buildLengths are always valid
+}
+
+void BlockCodec::encodeBlockWith(const unsigned char* data, size_t size, const CodeLengths& lengths,
+                                 bool storeTable, bool interleaved, std::vector<unsigned char>& out) {
+    CodeTable table;
+    CanonicalCode::buildCodeTable(lengths, table);
+
+    // The body is encoded first because its size goes in front of it. A lone
+    // symbol has the empty code, so there is no bitstream to split.
+    bool payload = size > 0 && table[data[0]].length > 0;
+    interleaved = interleaved && payload && size >= MIN_INTERLEAVED_SIZE;
+    std::vector<unsigned char> body;
+    {
+        BitWriter writer(body);
+        if (storeTable) CanonicalCode::writeLengths(writer, lengths);
+
+        if (interleaved) {
+            size_t counts[STREAMS];
+            splitStreams(size, counts);
+
+            std::vector<unsigned char> streams[STREAMS];
+            const unsigned char* next = data;
+            for (int s = 0; s < STREAMS; ++s) {
+                BitWriter streamWriter(streams[s]);
+                encodeSymbols(next, counts[s], table, streamWriter);
+                streamWriter.flush();
+                next += counts[s];
+            }
+
+            writer.flush();  // Streams start on a byte boundary
+            for (int s = 0; s < STREAMS - 1; ++s) {
+                writeVarint(writer, streams[s].size());
+            }
+            writer.flush();
+            for (const std::vector<unsigned char>& stream : streams) {
+                body.insert(body.end(), stream.begin(), stream.end());
+            }
+        } else {
+            encodeSymbols(data, size, table, writer);
+        }
+    }
+
+    unsigned char flags = 0;
+    if (!storeTable) flags |= HPF_BLOCK_REUSE_TABLE;
+    if (interleaved) flags |= HPF_BLOCK_INTERLEAVED;
+
+    BitWriter writer(out);
+    writer.writeByte(flags);
+    writeVarint(writer, size);
+    writeVarint(writer, body.size());
+    writer.flush();
+    out.insert(out.end(), body.begin(), body.end());
+}
+
+void BlockCodec::writeEndMarker(std::vector<unsigned char>& out) {
+    out.push_back(HPF_BLOCK_END);
+}
+
+void BlockCodec::writeIndex(const std::vector<BlockIndexEntry>& index, uint64_t indexOffset,
+                            std::vector<unsigned char>& out) {
+    BitWriter writer(out);
+    writeVarint(writer, index.size());
+    for (const BlockIndexEntry& entry : index) {
+        writer.writeByte(entry.flags);
+        writeVarint(writer, entry.rawSize);
+        writeVarint(writer, entry.storedSize);
+    }
+
+    for (int i = 7; i >= 0; --i) {
+        writer.writeByte(static_cast<unsigned char>(indexOffset >> (i * 8)));
+    }
+    for (unsigned char byte : HPF_INDEX_MAGIC) {
+        writer.writeByte(byte);
+    }
+}
+
+bool BlockCodec::readIndex(std::istream& input, std::vector<BlockIndexEntry>& index) {
+    index.clear();
+
+    input.seekg(0, std::ios::end);
+    std::streamoff fileSize = input.tellg();
+    if (fileSize < HPF_TRAILER_SIZE) return false;
+
+    unsigned char trailer[HPF_TRAILER_SIZE];
+    input.seekg(fileSize - HPF_TRAILER_SIZE);
+    if (!input.read(reinterpret_cast<char*>(trailer), HPF_TRAILER_SIZE)) return false;
+    if (!std::equal(std::begin(HPF_INDEX_MAGIC), std::end(HPF_INDEX_MAGIC), trailer + 8)) return false;
+
+    uint64_t indexOffset = 0;
+    for (int i = 0; i < 8; ++i) {
+        indexOffset = (indexOffset << 8) | trailer[i];
+    }
+    if (indexOffset > static_cast<uint64_t>(fileSize - HPF_TRAILER_SIZE)) return false;
+
+    std::vector<unsigned char> bytes(static_cast<size_t>(fileSize - HPF_TRAILER_SIZE - indexOffset));
+    input.seekg(static_cast<std::streamoff>(indexOffset));
+    if (!input.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return false;
+
+    BitReader reader(bytes.data(), bytes.size());
+    uint64_t count;
+    if (!readVarint(reader, count) || count > bytes.size()) return false;
+
+    // The blocks must fill the stream exactly: magic and version, blocks, end marker
+    uint64_t position = sizeof(HPF_MAGIC) + 1;
+    index.resize(static_cast<size_t>(count));
+    for (BlockIndexEntry& entry : index) {
+        unsigned char flags;
+        if (!reader.readByte(flags) || !readVarint(reader, entry.rawSize) ||
+            !readVarint(reader, entry.storedSize)) {
+            return false;
+        }
+        entry.flags = flags;
+        if ((flags & ~(HPF_BLOCK_REUSE_TABLE | HPF_BLOCK_INTERLEAVED)) || entry.rawSize == 0 || entry.rawSize > MAX_BLOCK_SIZE ||
+            entry.storedSize > indexOffset) {
+            return false;
+        }
+        position += entry.storedSize;
+    }
+    if (!index.empty() && (index.front().flags & HPF_BLOCK_REUSE_TABLE)) return false;
+    return position + 1 == indexOffset;
+}
+
+bool BlockCodec::readHeader(BitReader& reader, BlockHeader& header) {
+    header = BlockHeader{};
+
+    unsigned char flags;
+    if (!reader.readByte(flags)) return false;
+    header.flags = flags;
+    if (flags == HPF_BLOCK_END) return true;
+    if (flags & ~(HPF_BLOCK_REUSE_TABLE | HPF_BLOCK_INTERLEAVED)) return false;  // Unknown flags
+
+    if (!readVarint(reader, header.rawSize) || !readVarint(reader, header.bodySize)) return false;
+
+    // A code is at most 32 bits per byte, plus the length table
+    return header.rawSize > 0 && header.rawSize <= MAX_BLOCK_SIZE &&
+           header.bodySize <= header.rawSize * 4 + 1024;
+}
+
+bool BlockCodec::readIndexedBlock(std::istream& input, const BlockIndexEntry& entry,
+                                  std::vector<unsigned char>& stored, BlockHeader& header,
+                                  const unsigned char*& body) {
+    stored.resize(static_cast<size_t>(entry.storedSize));
+    if (!input.read(reinterpret_cast<char*>(stored.data()), stored.size())) return false;
+    return readIndexedBlock(stored.data(), entry, header, body);
+}
+
+bool BlockCodec::readIndexedBlock(const unsigned char* stored, const BlockIndexEntry& entry,
+                                  BlockHeader& header, const unsigned char*& body) {
+    size_t storedSize = static_cast<size_t>(entry.storedSize);
+    BitReader reader(stored, storedSize);
+    if (!readHeader(reader, header) || header.flags != entry.flags ||
+        header.rawSize != entry.rawSize || header.bodySize > storedSize) {
+        return false;
+    }
+    body = stored + (storedSize - header.bodySize);
+    return true;
+}
+
+bool BlockCodec::loadTable(const BlockHeader& header, const unsigned char* body,
+                           DecodeTable& table, bool multiSymbol) {
+    if (header.flags & HPF_BLOCK_REUSE_TABLE) return false;
+
+    BitReader reader(body, static_cast<size_t>(header.bodySize));
+    CodeLengths lengths;
+    return CanonicalCode::readLengths(reader, lengths) && table.build(lengths, multiSymbol);
+}
+
+bool BlockCodec::decodeBody(const BlockHeader& header, const unsigned char* body,
+                            unsigned char* output, DecodeTable& table, bool multiSymbol) {
+    BitReader reader(body, static_cast<size_t>(header.bodySize));
+
+    if (!(header.flags & HPF_BLOCK_REUSE_TABLE)) {
+        CodeLengths lengths;
+        if (!CanonicalCode::readLengths(reader, lengths) || !table.build(lengths, multiSymbol)) {
+            return false;
+        }
+    }
+
+    size_t size = static_cast<size_t>(header.rawSize);
+    if (header.flags & HPF_BLOCK_INTERLEAVED) {
+        reader.alignToByte();
+        uint64_t streamSizes[STREAMS];
+        uint64_t leadingSize = 0;
+        const unsigned char* end = body + header.bodySize;
+        for (int s = 0; s < STREAMS - 1; ++s) {
+            if (!readVarint(reader, streamSizes[s])) return false;
+
+            // Each stream must fit in what is left of the body, so the sum cannot wrap
+            uint64_t left = static_cast<uint64_t>(end - reader.bytePosition());
+            if (leadingSize > left || streamSizes[s] > left - leadingSize) return false;
+            leadingSize += streamSizes[s];
+        }
+
+        const unsigned char* start = reader.bytePosition();
+        if (leadingSize > static_cast<uint64_t>(end - start)) return false;
+        streamSizes[STREAMS - 1] = (end - start) - leadingSize;
+
+        size_t counts[STREAMS];
+        splitStreams(size, counts);
+
+        const unsigned char* streams[STREAMS];
+        size_t sizes[STREAMS];
+        unsigned char* outputs[STREAMS];
+        for (int s = 0; s < STREAMS; ++s) {
+            streams[s] = start;
+            sizes[s] = static_cast<size_t>(streamSizes[s]);
+            outputs[s] = output;
+            start += sizes[s];
+            output += counts[s];
+        }
+        return table.decodeInterleaved(streams, sizes, outputs, counts);
+    }
+
+    size_t decoded = multiSymbol ? table.decodeMulti(reader, output, size)
+                                 : table.decode(reader, output, size);
+    return decoded == size;
+}
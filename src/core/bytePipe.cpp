@@ -0,0 +1,72 @@
+#include "bytePipe.h"
+
+BytePipe::BytePipe(size_t chunkSize, size_t maxChunks)
+    : chunkSize(chunkSize > 0 ? chunkSize : 1), maxChunks(maxChunks > 0 ? maxChunks : 1) {}
+
+void BytePipe::closeWrite() {
+    writer.flushChunk();
+    std::lock_guard<std::mutex> lock(mutex);
+    writeClosed = true;
+    changed.notify_all();
+}
+
+void BytePipe::closeRead() {
+    std::lock_guard<std::mutex> lock(mutex);
+    readClosed = true;
+    chunks.clear();
+    changed.notify_all();
+}
+
+// Hands a filled chunk to the reader, waiting for room; false once the reader has hung up
+bool BytePipe::push(std::vector<char>& chunk) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return readClosed || chunks.size() < maxChunks; });
+    if (readClosed) return false;
+    chunks.push_back(std::move(chunk));
+    changed.notify_all();
+    return true;
+}
+
+// Takes the next chunk, waiting for one; false at the end of the stream
+bool BytePipe::pop(std::vector<char>& chunk) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return readClosed || writeClosed || !chunks.empty(); });
+    if (chunks.empty()) return false;
+    chunk = std::move(chunks.front());
+    chunks.pop_front();
+    changed.notify_all();
+    return true;
+}
+
+// Passes on the bytes written since the last chunk
+bool BytePipe::Writer::flushChunk() {
+    if (pptr() == pbase()) return true;
+    chunk.resize(static_cast<size_t>(pptr() - pbase()));
+    bool passed = pipe.push(chunk);
+    chunk.clear();
+    setp(nullptr, nullptr);
+    return passed;
+}
+
+BytePipe::Writer::int_type BytePipe::Writer::overflow(int_type ch) {
+    if (!flushChunk()) return traits_type::eof();
+    if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+
+    // A moved-from chunk is empty: start a new one
+    chunk.resize(pipe.chunkSize);
+    setp(chunk.data(), chunk.data() + chunk.size());
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+    return ch;
+}
+
+int BytePipe::Writer::sync() {
+    return flushChunk() ? 0 : -1;
+}
+
+BytePipe::Reader::int_type BytePipe::Reader::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (!pipe.pop(chunk)) return traits_type::eof();
+    setg(chunk.data(), chunk.data(), chunk.data() + chunk.size());
+    return traits_type::to_int_type(*gptr());
+}
@@ -0,0 +1,253 @@
+#include "canonicalCode.h"
+#include "hpfFormat.h"
+
+#include <algorithm>
+#include <vector>
+#include <utility>
+
+// A zero run costs width bits per entry inside a range, or about two varint
+// bytes to close the range and open the next one. Split when that is cheaper.
+static const int RANGE_SPLIT_COST = 16;
+
+// Huffman's algorithm over plain arrays: leaves sorted by weight feed one
+// queue, merged nodes are created in non-decreasing weight order and form the
+// second, so the two smallest weights are always at the queue heads.
+static void computeLengths(const FrequencyTable& freqs, CodeLengths& lengths) {
+    lengths.fill(0);
+
+    std::vector<std::pair<uint64_t, int>> leaves;  // (weight, byte)
+    for (int byte = 0; byte < 256; ++byte) {
+        if (freqs[byte] > 0) leaves.emplace_back(freqs[byte], byte);
+    }
+
+    const int n = static_cast<int>(leaves.size());
+    if (n == 0) return;
+    if (n == 1) {
+        lengths[leaves[0].second] = 1;
+        return;
+    }
+
+    std::sort(leaves.begin(), leaves.end());
+
+    // Nodes 0..n-1 are leaves, n..2n-2 merged nodes; the root is last
+    std::vector<uint64_t> weight(2 * n - 1);
+    std::vector<int> parent(2 * n - 1, 0);
+    for (int i = 0; i < n; ++i) weight[i] = leaves[i].first;
+
+    int nextLeaf = 0;
+    int nextNode = n;
+    for (int i = n; i < 2 * n - 1; ++i) {
+        int picked[2];
+        for (int& p : picked) {
+            bool useLeaf = nextLeaf < n && (nextNode >= i || weight[nextLeaf] <= weight[nextNode]);
+            p = useLeaf ? nextLeaf++ : nextNode++;
+        }
+        weight[i] = weight[picked[0]] + weight[picked[1]];
+        parent[picked[0]] = parent[picked[1]] = i;
+    }
+
+    // Parents always come after their children, so one backwards pass yields every depth
+    std::vector<int> depth(2 * n - 1, 0);
+    for (int i = 2 * n - 3; i >= 0; --i) {
+        depth[i] = depth[parent[i]] + 1;
+    }
+    for (int i = 0; i < n; ++i) {
+        lengths[leaves[i].second] = static_cast<uint8_t>(depth[i]);
+    }
+}
+
+// Package-merge (Larmore & Hirschberg): the optimal prefix code with no length
+// above maxLength. Each round pairs neighbours of the previous list into
+// packages and merges them with the leaves; a symbol's code length is how many
+// times it appears in the first 2n-2 items of the final list.
+static void computeLimitedLengths(const FrequencyTable& freqs, int maxLength, CodeLengths& lengths) {
+    struct Item {
+        uint64_t weight;
+        int symbol;      // Byte value for leaves, -1 for packages
+        int left, right; // Package contents (indices into pool)
+    };
+
+    lengths.fill(0);
+
+    std::vector<Item> pool;
+    for (int byte = 0; byte < 256; ++byte) {
+        if (freqs[byte] > 0) pool.push_back({freqs[byte], byte, -1, -1});
+    }
+    std::sort(pool.begin(), pool.end(), [](const Item& a, const Item& b) {
+        return a.weight != b.weight ? a.weight < b.weight : a.symbol < b.symbol;
+    });
+
+    const int n = static_cast<int>(pool.size());
+    std::vector<int> current(n);
+    for (int i = 0; i < n; ++i) current[i] = i;
+
+    for (int level = 1; level < maxLength; ++level) {
+        std::vector<int> packages;
+        for (size_t k = 0; k + 1 < current.size(); k += 2) {
+            pool.push_back({pool[current[k]].weight + pool[current[k + 1]].weight, -1, current[k], current[k + 1]});
+            packages.push_back(static_cast<int>(pool.size()) - 1);
+        }
+
+        // Merge leaves (indices 0..n-1, already sorted) with the packages, leaves first on ties
+        std::vector<int> merged;
+        merged.reserve(n + packages.size());
+        size_t leaf = 0, package = 0;
+        while (leaf < static_cast<size_t>(n) || package < packages.size()) {
+            bool takeLeaf = package == packages.size() ||
+                            (leaf < static_cast<size_t>(n) && pool[leaf].weight <= pool[packages[package]].weight);
+            merged.push_back(takeLeaf ? static_cast<int>(leaf++) : packages[package++]);
+        }
+        current.swap(merged);
+    }
+
+    std::vector<int> stack(current.begin(), current.begin() + (2 * n - 2));
+    while (!stack.empty()) {
+        const Item& item = pool[stack.back()];
+        stack.pop_back();
+        if (item.symbol >= 0) {
+            lengths[item.symbol]++;
+        } else {
+            stack.push_back(item.left);
+            stack.push_back(item.right);
+        }
+    }
+}
+
+CodeLengths CanonicalCode::buildLengths(const FrequencyTable& freqs, int maxLength) {
+    // The cap must leave room for every present symbol: 2^maxLength >= symbol count
+    int symbolCount = static_cast<int>(std::count_if(freqs.begin(), freqs.end(), [](uint64_t f) { return f > 0; }));
+    int minLength = 1;
+    while ((1 << minLength) < symbolCount) ++minLength;
+    if (maxLength <= 0 || maxLength > MAX_CODE_LENGTH) maxLength = MAX_CODE_LENGTH;
+    maxLength = std::max(maxLength, minLength);
+
+    // Plain Huffman is optimal whenever it already respects the cap
+    CodeLengths lengths;
+    computeLengths(freqs, lengths);
+    if (*std::max_element(lengths.begin(), lengths.end()) > maxLength) {
+        computeLimitedLengths(freqs, maxLength, lengths);
+    }
+    return lengths;
+}
+
+// A code with a single symbol needs no bits to tell it apart: that symbol keeps
+// length 1 in the table but is coded as the empty string
+static bool isLoneCode(const CodeLengths& lengths) {
+    return std::count_if(lengths.begin(), lengths.end(), [](uint8_t length) { return length > 0; }) == 1;
+}
+
+uint64_t CanonicalCode::encodedBits(const FrequencyTable& frequencies, const CodeLengths& lengths) {
+    if (isLoneCode(lengths)) return 0;
+
+    uint64_t bits = 0;
+    for (int byte = 0; byte < 256; ++byte) {
+        bits += frequencies[byte] * lengths[byte];
+    }
+    return bits;
+}
+
+bool CanonicalCode::assignCodes(const CodeLengths& lengths, CodeBits& codes) {
+    std::array<uint32_t, MAX_CODE_LENGTH + 1> lengthCount{};
+    for (uint8_t length : lengths) {
+        if (length > MAX_CODE_LENGTH) return false;
+        lengthCount[length]++;
+    }
+    lengthCount[0] = 0;
+
+    // Kraft inequality: the lengths must not claim more than the whole code space
+    int64_t unused = 1;
+    for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        unused = (unused << 1) - lengthCount[length];
+        if (unused < 0) return false;
+    }
+
+    // First code of each length, as in RFC 1951 section 3.2.2
+    std::array<uint64_t, MAX_CODE_LENGTH + 1> nextCode{};
+    uint64_t code = 0;
+    for (int length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        code = (code + lengthCount[length - 1]) << 1;
+        nextCode[length] = code;
+    }
+
+    codes.fill(0);
+    for (int byte = 0; byte < 256; ++byte) {
+        if (lengths[byte] > 0) {
+            codes[byte] = static_cast<uint32_t>(nextCode[lengths[byte]]++);
+        }
+    }
+    return true;
+}
+
+bool CanonicalCode::buildCodeTable(const CodeLengths& lengths, CodeTable& table) {
+    CodeBits codes;
+    if (!assignCodes(lengths, codes)) return false;
+
+    bool lone = isLoneCode(lengths);
+    for (int byte = 0; byte < 256; ++byte) {
+        table[byte] = HuffmanCode{codes[byte], static_cast<uint8_t>(lone ? 0 : lengths[byte])};
+    }
+    return true;
+}
+
+void CanonicalCode::writeLengths(BitWriter& writer, const CodeLengths& lengths) {
+    int maxLength = *std::max_element(lengths.begin(), lengths.end());
+    int width = 1;
+    while ((1 << width) <= maxLength) ++width;
+
+    // Group present bytes into ranges, absorbing zero runs that are cheaper to store inline
+    std::vector<std::pair<int, int>> ranges;  // [start, end)
+    int byte = 0;
+    while (byte < 256) {
+        if (lengths[byte] == 0) { ++byte; continue; }
+
+        int start = byte;
+        int end = byte + 1;
+        while (end < 256) {
+            int zeros = 0;
+            while (end + zeros < 256 && lengths[end + zeros] == 0) ++zeros;
+            if (zeros == 0) { ++end; continue; }
+            if (end + zeros == 256 || zeros * width > RANGE_SPLIT_COST) break;
+            end += zeros;
+        }
+        ranges.emplace_back(start, end);
+        byte = end;
+    }
+
+    writer.writeByte(static_cast<unsigned char>(width));
+    writeVarint(writer, ranges.size());
+
+    int previousEnd = 0;
+    for (const auto& [start, end] : ranges) {
+        writeVarint(writer, start - previousEnd);
+        writeVarint(writer, end - start);
+        for (int i = start; i < end; ++i) {
+            writer.writeBits(lengths[i], width);
+        }
+        previousEnd = end;
+    }
+}
+
+bool CanonicalCode::readLengths(BitReader& reader, CodeLengths& lengths) {
+    lengths.fill(0);
+
+    unsigned char width;
+    if (!reader.readByte(width) || width < 1 || width > 6) return false;
+
+    uint64_t rangeCount;
+    if (!readVarint(reader, rangeCount) || rangeCount > 128) return false;
+
+    uint64_t position = 0;
+    for (uint64_t r = 0; r < rangeCount; ++r) {
+        uint64_t gap, count;
+        if (!readVarint(reader, gap) || !readVarint(reader, count)) return false;
+        if (gap > 256 || count > 256 || position + gap + count > 256) return false;
+
+        position += gap;
+        for (uint64_t i = 0; i < count; ++i) {
+            uint32_t length;
+            if (!reader.readBits(width, length) || length > MAX_CODE_LENGTH) return false;
+            lengths[position++] = static_cast<uint8_t>(length);
+        }
+    }
+    return true;
+}
@@ -1,11 +1,20 @@
 #include "compressor.h"
 #include "bitWriter.h"
+#include "hpfFormat.h"
+#include "threadPool.h"
+#include "inputSource.h"
+#include "memoryStream.h"
 #include "config.h"
 
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <future>
 
 void Compressor::setLogger(LogCallback logCallback) {
     logger = logCallback;
@@ -15,32 +24,270 @@ void Compressor::setProgressCallback(ProgressCallback progCallback) {
     progress = progCallback;
 }
 
+void Compressor::setMaxCodeLength(int length) {
+    maxCodeLength = length;
+}
+
+void Compressor::setBlockSize(size_t size) {
+    blockSize = std::clamp<size_t>(size, 1, BlockCodec::MAX_BLOCK_SIZE);
+}
+
+void Compressor::setThreadCount(unsigned count) {
+    threadCount = count;
+}
+
+void Compressor::setInterleaved(bool enabled) {
+    interleaved = enabled;
+}
+
+ErrorCode Compressor::compress(const std::string& inputFilename, const std::string& outputFilename) {
+    InputSource input;
+    if (input.open(inputFilename) != ErrorCode::Success) {
+        if (logger) logger("Error: Cannot open input file: " + inputFilename + "\n");
+        return ErrorCode::FileNotFound;
+    }
+
+    std::ofstream output(outputFilename, std::ios::binary);
+    if (!output.is_open()) {
+        if (logger) logger("Error: Cannot create output file: " + outputFilename + "\n");
+        return ErrorCode::FileCreateError;
+    }
+
+    ErrorCode result = compressSource(input, output);
+    output.close();
+
+    if (result == ErrorCode::Success && !output) {
+        if (logger) logger("Error: Failed writing output file: " + outputFilename + "\n");
+        return ErrorCode::FileWriteError;
+    }
+    if (result == ErrorCode::Success && logger) {
+        logger("Compression complete. Output: " + outputFilename + "\n");
+    }
+    return result;
+}
+
+ErrorCode Compressor::compress(std::istream& input, std::ostream& output) {
+    InputSource source;
+    source.attach(input);
+    ErrorCode result = compressSource(source, output);
+    output.flush();
+
+    if (result == ErrorCode::Success && (!output || input.bad())) {
+        if (logger) logger("Error: Failed streaming the compressed data.\n");
+        return input.bad() ? ErrorCode::FileReadError : ErrorCode::FileWriteError;
+    }
+    return result;
+}
+
+ErrorCode Compressor::compressBuffer(std::span<const std::byte> input, std::vector<std::byte>& output) {
+    InputSource source;
+    source.attach(reinterpret_cast<const unsigned char*>(input.data()), input.size());
+
+    output.clear();
+    MemoryOutputBuffer buffer(output);
+    std::ostream stream(&buffer);
+    return compressSource(source, stream);
+}
+
+ErrorCode Compressor::compressBuffer(std::span<const std::byte> input, std::span<std::byte> output,
+                                     size_t& written) {
+    InputSource source;
+    source.attach(reinterpret_cast<const unsigned char*>(input.data()), input.size());
+
+    MemoryOutputBuffer buffer(output);
+    std::ostream stream(&buffer);
+    ErrorCode result = compressSource(source, stream);
+    written = buffer.size();
+
+    if (result == ErrorCode::Success && buffer.overflowed()) {
+        if (logger) logger("Error: Compressed data does not fit the output buffer.\n");
+        return ErrorCode::BufferTooSmall;
+    }
+    return result;
+}
+
+size_t Compressor::compressBound(size_t inputSize) const {
+    size_t blocks = inputSize / blockSize + (inputSize % blockSize != 0);
+    return sizeof(HPF_MAGIC) + 1 + inputSize +
+           blocks * (BlockCodec::MAX_BLOCK_OVERHEAD + BlockCodec::MAX_INDEX_ENTRY_SIZE) +
+           BlockCodec::MAX_INDEX_OVERHEAD;
+}
+
+// Header, blocks, end marker and index, written strictly in order so the output
+// never needs to be seekable
+ErrorCode Compressor::compressSource(InputSource& input, std::ostream& output) {
+    // Only used for progress and to skip the pool for single-block inputs
+    bool sizeKnown = input.hasSize();
+    uint64_t expectedSize = input.size();
+
+    std::vector<unsigned char> encoded;
+    {
+        BitWriter writer(encoded);
+        writeFormatHeader(writer, HPF_VERSION_BLOCKS);
+    }
+    output.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+    encoded.clear();
+
+    originalFileSize = 0;
+    blockIndex.clear();
+    reusedTables = 0;
+    totalStats = BlockStats{};
+
+    unsigned threads = threadCount > 0 ? threadCount : ThreadPool::hardwareThreads();
+    if (threads > 1 && (!sizeKnown || expectedSize > blockSize)) {
+        compressBlocksParallel(input, output, threads, expectedSize);
+    } else {
+        compressBlocks(input, output, expectedSize);
+    }
+
+    // End marker, then the index that lets readers find blocks without scanning
+    uint64_t indexOffset = sizeof(HPF_MAGIC) + 1 + 1;
+    for (const BlockIndexEntry& entry : blockIndex) {
+        indexOffset += entry.storedSize;
+    }
+    BlockCodec::writeEndMarker(encoded);
+    BlockCodec::writeIndex(blockIndex, indexOffset, encoded);
+    output.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+
+    if (logger) {
+        std::stringstream ss;
+        ss << "Encoded " << originalFileSize << " bytes in " << blockIndex.size() << " block(s), "
+           << reusedTables << " reusing the previous table\n";
+        ss << "Longest code: " << totalStats.longestCode << " bits (" << totalStats.longestUnlimited << " without a cap)";
+        if (totalStats.payloadBits > totalStats.unlimitedBits) {
+            uint64_t extraBits = totalStats.payloadBits - totalStats.unlimitedBits;
+            ss << ", cap costs " << (extraBits + 7) / 8 << " bytes (+"
+               << std::setprecision(3) << 100.0 * extraBits / totalStats.unlimitedBits << "%)";
+        }
+        ss << "\n";
+        logger(ss.str());
+    }
+    return ErrorCode::Success;
+}
+
+// One thread: blocks are coded as they are read and may reuse the previous table
+void Compressor::compressBlocks(InputSource& input, std::ostream& output, uint64_t expectedSize) {
+    std::vector<unsigned char> encoded;
+    CodeLengths previousLengths{};
+    int sharedTableBlocks = 0;
+    BlockStats stats;
+
+    const unsigned char* block;
+    while (size_t bytesRead = input.next(block, blockSize)) {
+        BlockCodec::encodeBlock(block, bytesRead, maxCodeLength, interleaved, encoded,
+                                &previousLengths, logger ? &stats : nullptr);
+        output.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        recordBlock(encoded, stats, bytesRead, expectedSize);
+
+        // Start a fresh table once enough blocks share this one
+        sharedTableBlocks = (encoded[0] & HPF_BLOCK_REUSE_TABLE) ? sharedTableBlocks + 1 : 1;
+        if (sharedTableBlocks == BlockCodec::MAX_SHARED_TABLE_BLOCKS) previousLengths.fill(0);
+        encoded.clear();
+    }
+}
+
+// Several threads: the reader hands blocks to the pool and writes them back in
+// input order. At most two blocks per thread are in flight, so memory use does
+// not grow with the input. Blocks are independent here, so none reuses a table.
+// A mapped input is coded in place; otherwise each block is copied out first.
+void Compressor::compressBlocksParallel(InputSource& input, std::ostream& output,
+                                        unsigned threads, uint64_t expectedSize) {
+    struct PendingBlock {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        std::vector<unsigned char> copy;
+        std::vector<unsigned char> encoded;
+        BlockStats stats;
+        std::future<void> done;
+    };
+
+    const size_t maxInFlight = 2 * static_cast<size_t>(threads);
+    const bool wantStats = static_cast<bool>(logger);
+
+    // Declared before the pool so a pool unwinding on error never outlives the blocks
+    std::deque<std::unique_ptr<PendingBlock>> inFlight;
+    std::vector<std::unique_ptr<PendingBlock>> spare;
+    ThreadPool pool(threads);
+
+    auto writeOldest = [&]() {
+        std::unique_ptr<PendingBlock> block = std::move(inFlight.front());
+        inFlight.pop_front();
+        block->done.get();
+        output.write(reinterpret_cast<const char*>(block->encoded.data()), block->encoded.size());
+        recordBlock(block->encoded, block->stats, block->size, expectedSize);
+        spare.push_back(std::move(block));
+    };
+
+    const unsigned char* chunk;
+    while (size_t bytesRead = input.next(chunk, blockSize)) {
+        std::unique_ptr<PendingBlock> block;
+        if (spare.empty()) {
+            block = std::make_unique<PendingBlock>();
+        } else {
+            block = std::move(spare.back());
+            spare.pop_back();
+        }
+
+        if (input.isMapped()) {
+            block->data = chunk;
+        } else {
+            block->copy.assign(chunk, chunk + bytesRead);
+            block->data = block->copy.data();
+        }
+        block->size = bytesRead;
+        block->encoded.clear();
+
+        PendingBlock* pending = block.get();
+        int maxLength = maxCodeLength;
+        bool split = interleaved;
+        pending->done = pool.submit([pending, maxLength, split, wantStats]() {
+            BlockCodec::encodeBlock(pending->data, pending->size, maxLength, split,
+                                    pending->encoded, nullptr, wantStats ? &pending->stats : nullptr);
+        });
+        inFlight.push_back(std::move(block));
+
+        if (inFlight.size() >= maxInFlight) writeOldest();
+    }
+
+    while (!inFlight.empty()) writeOldest();
+}
+
+void Compressor::recordBlock(const std::vector<unsigned char>& encoded, const BlockStats& stats,
+                             size_t size, uint64_t expectedSize) {
+    blockIndex.push_back({encoded[0], size, encoded.size()});
+
+    totalStats.payloadBits += stats.payloadBits;
+    totalStats.unlimitedBits += stats.unlimitedBits;
+    totalStats.longestCode = std::max(totalStats.longestCode, stats.longestCode);
+    totalStats.longestUnlimited = std::max(totalStats.longestUnlimited, stats.longestUnlimited);
+    if (stats.reusedTable) ++reusedTables;
+
+    originalFileSize += size;
+    if (progress && expectedSize > 0) {
+        progress(std::min(100.0f, static_cast<float>(originalFileSize) / expectedSize * 100.0f));
+    }
+}
+
 ErrorCode Compressor::readFileAndBuildFrequency(const std::string& filename) {
-    std::ifstream input(filename, std::ios::binary);
-    if (!input.is_open()) {
+    InputSource input;
+    if (input.open(filename) != ErrorCode::Success) {
         if (logger) logger("Error: Could not open file " + filename + "\n");
         return ErrorCode::FileNotFound;
     }
 
-    freqMap.clear();
     originalFileSize = 0;
 
     const size_t BUFFER_SIZE = 64 * 1024; // 64KB
-    std::vector<char> buffer(BUFFER_SIZE);
-
-    while (input) {
-        input.read(buffer.data(), BUFFER_SIZE);
-        std::streamsize bytesRead = input.gcount();
-        if (bytesRead == 0) break;
+    const unsigned char* chunk;
+    Histogram histogram;
 
-        for (std::streamsize i = 0; i < bytesRead; ++i) {
-            unsigned char byte = static_cast<unsigned char>(buffer[i]);
-            freqMap[byte]++;
-            originalFileSize++;
-        }
+    while (size_t bytesRead = input.next(chunk, BUFFER_SIZE)) {
+        histogram.add(chunk, bytesRead);
+        originalFileSize += bytesRead;
     }
 
     input.close();
+    frequencies = histogram.merge();
 
     if (originalFileSize == 0) {
         if (logger) logger("Error: Input file is empty.\n");
@@ -50,8 +297,8 @@ ErrorCode Compressor::readFileAndBuildFrequency(const std::string& filename) {
     return ErrorCode::Success;
 }
 
-const std::unordered_map<unsigned char, int>& Compressor::getFrequencyMap() const {
-    return freqMap;
+const FrequencyTable& Compressor::getFrequencyMap() const {
+    return frequencies;
 }
 
 uint64_t Compressor::getOriginalFileSize() const {
@@ -67,8 +314,8 @@ ErrorCode Compressor::compressFile(const std::string& inputFilename,
         return ErrorCode::UnknownError;
     }
 
-    std::ifstream input(inputFilename, std::ios::binary);
-    if (!input.is_open()) {
+    InputSource input;
+    if (input.open(inputFilename) != ErrorCode::Success) {
         if (logger) logger("Error: Cannot open input file: " + inputFilename + "\n");
         return ErrorCode::FileNotFound;
     }
@@ -97,47 +344,67 @@ ErrorCode Compressor::compressFile(const std::string& inputFilename,
         writer.writeByte(sizeByte);
     }
 
-    // Encode input file using Huffman codes
+    // Pack the string codes into a per-byte integer table once, so the encode
+    // loop does an array lookup instead of a hash lookup per input byte.
+    // Codes too long for 32 bits stay in the map and take the slow path.
+    CodeTable table{};
+    for (const auto& [byte, code] : codes) {
+        if (code.empty() || code.size() > 32) continue;
+        uint32_t bits = 0;
+        for (char c : code) bits = (bits << 1) | (c == '1');
+        table[byte] = HuffmanCode{bits, static_cast<uint8_t>(code.size())};
+    }
+
+    ErrorCode result = encodeStream(input, writer, table, &codes);
+    if (result != ErrorCode::Success) return result;
+
+    writer.flush();
+
+    input.close();
+    output.close();
+
+    if (logger) {
+        logger("Compression complete. Output: " + outputFilename + "\n");
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode Compressor::encodeStream(InputSource& input, BitWriter& writer, const CodeTable& table,
+                                   const std::unordered_map<unsigned char, std::string>* longCodes) {
     const size_t BUFFER_SIZE = 64 * 1024; // 64KB
-    std::vector<char> buffer(BUFFER_SIZE);
+    const unsigned char* buffer;
     uint64_t bytesProcessed = 0;
 
-    while (input) {
-        input.read(buffer.data(), BUFFER_SIZE);
-        std::streamsize bytesRead = input.gcount();
-        if (bytesRead == 0) break;
-
-        for (std::streamsize i = 0; i < bytesRead; ++i) {
-            unsigned char byte = static_cast<unsigned char>(buffer[i]);
-            auto it = codes.find(byte);
-            if (it == codes.end()) {
-                if (logger) {
-                    std::stringstream ss;
-                    ss << "Error: No Huffman code found for byte: " << static_cast<int>(byte) << "\n";
-                    logger(ss.str());
+    while (size_t bytesRead = input.next(buffer, BUFFER_SIZE)) {
+        for (size_t i = 0; i < bytesRead; ++i) {
+            unsigned char byte = buffer[i];
+            const HuffmanCode& code = table[byte];
+            if (code.length != 0) {
+                writer.writeBits(code.bits, code.length);
+                continue;
+            }
+
+            if (longCodes) {
+                auto it = longCodes->find(byte);
+                if (it != longCodes->end()) {
+                    writer.writeBits(it->second);
+                    continue;
                 }
-                input.close();
-                output.close();
-                return ErrorCode::CompressionFailed;
             }
 
-            const std::string& code = it->second;
-            writer.writeBits(code);
+            if (logger) {
+                std::stringstream ss;
+                ss << "Error: No Huffman code found for byte: " << static_cast<int>(byte) << "\n";
+                logger(ss.str());
+            }
+            return ErrorCode::CompressionFailed;
         }
-        
+
         bytesProcessed += bytesRead;
         if (progress && originalFileSize > 0) {
             progress(static_cast<float>(bytesProcessed) / originalFileSize * 100.0f);
         }
     }
 
-    writer.flush();
-
-    input.close();
-    output.close();
-
-    if (logger) {
-        logger("Compression complete. Output: " + outputFilename + "\n");
-    }
     return ErrorCode::Success;
-}
\ No newline at end of file
+}
@@ -0,0 +1,95 @@
+#include "crc32.h"
+
+#include <array>
+
+using Crc32Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+// tables[k][b]: CRC of byte b followed by k zero bytes (slicing-by-8)
+static constexpr Crc32Tables buildTables() {
+    Crc32Tables tables{};
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        tables[0][byte] = crc;
+    }
+    for (int k = 1; k < 8; ++k) {
+        for (int byte = 0; byte < 256; ++byte) {
+            uint32_t previous = tables[k - 1][byte];
+            tables[k][byte] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr Crc32Tables TABLES = buildTables();
+
+static inline uint32_t load32(const unsigned char* p) {
+    return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+           static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t size) {
+    crc = ~crc;
+    while (size >= 8) {
+        uint32_t low = load32(data) ^ crc;
+        uint32_t high = load32(data + 4);
+        crc = TABLES[7][low & 0xFF] ^ TABLES[6][(low >> 8) & 0xFF] ^
+              TABLES[5][(low >> 16) & 0xFF] ^ TABLES[4][low >> 24] ^
+              TABLES[3][high & 0xFF] ^ TABLES[2][(high >> 8) & 0xFF] ^
+              TABLES[1][(high >> 16) & 0xFF] ^ TABLES[0][high >> 24];
+        data += 8;
+        size -= 8;
+    }
+    while (size-- > 0) {
+        crc = TABLES[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Appending n zero bits to a message is linear over GF(2): a 32x32 bit matrix.
+// Squaring it doubles n, so the operator for any size takes log2(size) squarings.
+static uint32_t matrixTimes(const uint32_t* matrix, uint32_t vector) {
+    uint32_t sum = 0;
+    for (; vector; vector >>= 1, ++matrix) {
+        if (vector & 1) sum ^= *matrix;
+    }
+    return sum;
+}
+
+static void matrixSquare(uint32_t* square, const uint32_t* matrix) {
+    for (int n = 0; n < 32; ++n) {
+        square[n] = matrixTimes(matrix, matrix[n]);
+    }
+}
+
+uint32_t crc32Combine(uint32_t crcFirst, uint32_t crcSecond, uint64_t secondSize) {
+    if (secondSize == 0) return crcFirst;
+
+    uint32_t even[32];  // Operator for 2^k zero bits, k even
+    uint32_t odd[32];   // and k odd
+
+    odd[0] = 0xEDB88320u;  // One zero bit
+    uint32_t row = 1;
+    for (int n = 1; n < 32; ++n) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    matrixSquare(even, odd);  // Two zero bits
+    matrixSquare(odd, even);  // Four zero bits
+
+    // Apply secondSize zero bytes to the first CRC, one bit of the size at a time
+    do {
+        matrixSquare(even, odd);
+        if (secondSize & 1) crcFirst = matrixTimes(even, crcFirst);
+        secondSize >>= 1;
+        if (secondSize == 0) break;
+
+        matrixSquare(odd, even);
+        if (secondSize & 1) crcFirst = matrixTimes(odd, crcFirst);
+        secondSize >>= 1;
+    } while (secondSize != 0);
+
+    return crcFirst ^ crcSecond;
+}
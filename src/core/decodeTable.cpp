@@ -0,0 +1,386 @@
+#include "decodeTable.h"
+#include "huffmanTree.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Depth of the deepest leaf below `node` (a leaf itself has depth 0)
+static int subtreeDepth(const HuffmanNode* node) {
+    if (!node || node->isLeaf()) return 0;
+    return 1 + std::max(subtreeDepth(node->left), subtreeDepth(node->right));
+}
+
+void DecodeTable::reset() {
+    entries.assign(size_t(1) << ROOT_BITS, Entry{});
+    multiEntries.clear();
+    root = nullptr;
+    singleSymbol = false;
+    singleByte = 0;
+    lengthCount.fill(0);
+    sortedSymbols.clear();
+}
+
+bool DecodeTable::build(const HuffmanNode* tree, bool multiSymbol) {
+    reset();
+    root = tree;
+
+    if (!tree) return false;
+
+    // A tree with one leaf assigns it the empty code, so the stream carries no bits at all
+    if (tree->isLeaf()) {
+        singleSymbol = true;
+        singleByte = tree->byte;
+        return true;
+    }
+
+    fillRoot(tree, 0, 0);
+    if (multiSymbol) buildMulti();
+    return true;
+}
+
+bool DecodeTable::build(const CodeLengths& lengths, bool multiSymbol) {
+    reset();
+
+    CodeBits codes;
+    if (!CanonicalCode::assignCodes(lengths, codes)) return false;
+
+    for (int byte = 0; byte < 256; ++byte) {
+        lengthCount[lengths[byte]]++;
+    }
+    lengthCount[0] = 0;
+    for (int length = 1; length <= CanonicalCode::MAX_CODE_LENGTH; ++length) {
+        for (int byte = 0; byte < 256; ++byte) {
+            if (lengths[byte] == length) sortedSymbols.push_back(static_cast<unsigned char>(byte));
+        }
+    }
+    if (sortedSymbols.empty()) return false;
+
+    if (sortedSymbols.size() == 1) {
+        singleSymbol = true;
+        singleByte = sortedSymbols.front();
+        return true;
+    }
+
+    // Short codes fill their span of the root table directly
+    std::array<int, size_t(1) << ROOT_BITS> longest{};  // Longest code behind each root prefix
+    for (int byte = 0; byte < 256; ++byte) {
+        int length = lengths[byte];
+        if (length == 0) continue;
+
+        if (length <= ROOT_BITS) {
+            size_t first = size_t(codes[byte]) << (ROOT_BITS - length);
+            std::fill_n(entries.begin() + first, size_t(1) << (ROOT_BITS - length),
+                        Entry{static_cast<uint16_t>(byte), static_cast<uint8_t>(length), EntryKind::Leaf});
+        } else {
+            uint32_t prefix = codes[byte] >> (length - ROOT_BITS);
+            longest[prefix] = std::max(longest[prefix], length);
+        }
+    }
+
+    // Long codes share a sub-table per root prefix
+    for (size_t prefix = 0; prefix < longest.size(); ++prefix) {
+        if (longest[prefix] == 0) continue;
+        int width = std::min(longest[prefix] - ROOT_BITS, MAX_SUB_BITS);
+        size_t offset = entries.size();
+        entries.resize(offset + (size_t(1) << width));
+        entries[prefix] = Entry{static_cast<uint16_t>(offset), static_cast<uint8_t>(width), EntryKind::Sub};
+    }
+
+    for (int byte = 0; byte < 256; ++byte) {
+        int length = lengths[byte];
+        if (length <= ROOT_BITS) continue;
+
+        const Entry& sub = entries[codes[byte] >> (length - ROOT_BITS)];
+        int rest = length - ROOT_BITS;
+        if (rest > sub.length) continue;  // Left as Long
+
+        uint32_t low = codes[byte] & ((1u << rest) - 1);
+        size_t first = sub.value + (size_t(low) << (sub.length - rest));
+        std::fill_n(entries.begin() + first, size_t(1) << (sub.length - rest),
+                    Entry{static_cast<uint16_t>(byte), static_cast<uint8_t>(length), EntryKind::Leaf});
+    }
+
+    if (multiSymbol) buildMulti();
+    return true;
+}
+
+// Fills the root table. A leaf at depth d owns every index whose first d bits match its code.
+void DecodeTable::fillRoot(const HuffmanNode* node, uint32_t code, int depth) {
+    if (!node) return;
+
+    if (node->isLeaf()) {
+        size_t first = size_t(code) << (ROOT_BITS - depth);
+        size_t span = size_t(1) << (ROOT_BITS - depth);
+        std::fill_n(entries.begin() + first, span,
+                    Entry{node->byte, static_cast<uint8_t>(depth), EntryKind::Leaf});
+        return;
+    }
+
+    if (depth == ROOT_BITS) {
+        // Codes continue past the root table: hang a sub-table sized to this subtree
+        int width = std::min(subtreeDepth(node), MAX_SUB_BITS);
+        size_t offset = entries.size();
+        entries.resize(offset + (size_t(1) << width));
+        entries[code] = Entry{static_cast<uint16_t>(offset), static_cast<uint8_t>(width), EntryKind::Sub};
+        fillSub(node, offset, width, 0, 0);
+        return;
+    }
+
+    fillRoot(node->left, code << 1, depth + 1);
+    fillRoot(node->right, (code << 1) | 1, depth + 1);
+}
+
+// Fills a sub-table of `width` bits. Subtrees deeper than the table stay marked as Long.
+void DecodeTable::fillSub(const HuffmanNode* node, size_t offset, int width, uint32_t code, int depth) {
+    if (!node) return;
+
+    if (node->isLeaf()) {
+        size_t first = offset + (size_t(code) << (width - depth));
+        size_t span = size_t(1) << (width - depth);
+        std::fill_n(entries.begin() + first, span,
+                    Entry{node->byte, static_cast<uint8_t>(ROOT_BITS + depth), EntryKind::Leaf});
+        return;
+    }
+
+    if (depth == width) return;
+
+    fillSub(node->left, offset, width, code << 1, depth + 1);
+    fillSub(node->right, offset, width, (code << 1) | 1, depth + 1);
+}
+
+// For every root index, chains root lookups over the same bits for as long as
+// whole codes keep fitting. Only codes resolved by the root table take part.
+void DecodeTable::buildMulti() {
+    const size_t size = size_t(1) << ROOT_BITS;
+    const uint32_t mask = static_cast<uint32_t>(size - 1);
+    multiEntries.assign(size, MultiEntry{});
+
+    for (size_t index = 0; index < size; ++index) {
+        MultiEntry& multi = multiEntries[index];
+        int used = 0;
+        while (multi.count < MAX_MULTI_SYMBOLS) {
+            // Remaining bits of the index, shifted to the top (missing bits read as 0)
+            const Entry& entry = entries[(static_cast<uint32_t>(index) << used) & mask];
+            if (entry.kind != EntryKind::Leaf || entry.length > ROOT_BITS - used) break;
+            multi.symbols[multi.count++] = static_cast<unsigned char>(entry.value);
+            used += entry.length;
+        }
+        multi.length = static_cast<uint8_t>(used);
+    }
+}
+
+// Decodes a single symbol through the root table, a sub-table or the tree
+bool DecodeTable::decodeOne(BitReader& reader, unsigned char& symbol) const {
+    int available;
+    uint32_t bits = reader.peekBits(ROOT_BITS, available);
+    const Entry& entry = entries[bits];
+
+    if (entry.kind == EntryKind::Leaf) {
+        if (entry.length > available) return false;  // Stream ended mid-code
+        reader.consumeBits(entry.length);
+        symbol = static_cast<unsigned char>(entry.value);
+        return true;
+    }
+
+    if (entry.kind == EntryKind::Sub) {
+        uint32_t wide = reader.peekBits(ROOT_BITS + entry.length, available);
+        const Entry& sub = entries[entry.value + (wide & ((1u << entry.length) - 1))];
+        if (sub.kind == EntryKind::Leaf) {
+            if (sub.length > available) return false;
+            reader.consumeBits(sub.length);
+            symbol = static_cast<unsigned char>(sub.value);
+            return true;
+        }
+    }
+
+    return decodeSlow(reader, symbol);
+}
+
+size_t DecodeTable::decode(BitReader& reader, unsigned char* output, size_t count) const {
+    if (singleSymbol) {
+        std::fill_n(output, count, singleByte);
+        return count;
+    }
+
+    size_t decoded = 0;
+    while (decoded < count && decodeOne(reader, output[decoded])) {
+        ++decoded;
+    }
+    return decoded;
+}
+
+size_t DecodeTable::decodeMulti(BitReader& reader, unsigned char* output, size_t count) const {
+    if (singleSymbol || multiEntries.empty()) return decode(reader, output, count);
+
+    size_t decoded = 0;
+
+    // Fast path: while a full entry fits in the output, copy all of its symbols at once
+    while (decoded + MAX_MULTI_SYMBOLS <= count) {
+        int available;
+        uint32_t bits = reader.peekBits(ROOT_BITS, available);
+        const MultiEntry& multi = multiEntries[bits];
+
+        if (multi.count > 0 && multi.length <= available) {
+            std::copy_n(multi.symbols, MAX_MULTI_SYMBOLS, output + decoded);
+            decoded += multi.count;
+            reader.consumeBits(multi.length);
+            continue;
+        }
+
+        if (!decodeOne(reader, output[decoded])) return decoded;
+        ++decoded;
+    }
+
+    // Tail: finish symbol by symbol so we never decode past `count`
+    while (decoded < count && decodeOne(reader, output[decoded])) {
+        ++decoded;
+    }
+    return decoded;
+}
+
+// The streams' state and the table pointers live in locals rather than in
+// BitReaders and members, so the compiler can keep them in registers: byte
+// stores to the output may alias anything reached through a pointer and would
+// force a reload after every symbol. Each round refills every stream once
+// without a data-dependent branch, then takes LOOKUPS_PER_REFILL lookups from
+// each in turn. The four lookup chains do not depend on each other, so the CPU
+// runs them side by side.
+bool DecodeTable::decodeInterleaved(const unsigned char* const* streams, const size_t* sizes,
+                                    unsigned char* const* outputs, const size_t* counts) const {
+    if (singleSymbol || multiEntries.empty()) {
+        return decodeInterleavedWith<false>(streams, sizes, outputs, counts);
+    }
+    return decodeInterleavedWith<true>(streams, sizes, outputs, counts);
+}
+
+template <bool Multi>
+bool DecodeTable::decodeInterleavedWith(const unsigned char* const* streams, const size_t* sizes,
+                                        unsigned char* const* outputs, const size_t* counts) const {
+    constexpr int STREAMS = INTERLEAVED_STREAMS;
+    // A refill leaves at least 56 bits; one lookup consumes at most ROOT_BITS + MAX_SUB_BITS
+    constexpr int LOOKUPS_PER_REFILL = 56 / (ROOT_BITS + MAX_SUB_BITS);
+    constexpr size_t PER_ROUND = (Multi ? MAX_MULTI_SYMBOLS : 1) * LOOKUPS_PER_REFILL;
+
+    uint64_t bitBuffer[STREAMS] = {};
+    int bitCount[STREAMS] = {};
+    const unsigned char* cursor[STREAMS];
+    const unsigned char* end[STREAMS];
+    unsigned char* out[STREAMS];
+    unsigned char* outEnd[STREAMS];
+    for (int s = 0; s < STREAMS; ++s) {
+        cursor[s] = streams[s];
+        end[s] = streams[s] + sizes[s];
+        out[s] = outputs[s];
+        outEnd[s] = outputs[s] + counts[s];
+    }
+    const Entry* const table = entries.data();
+    const MultiEntry* const multiTable = multiEntries.data();
+
+    // Returns false, consuming nothing, on a code too long for both table levels
+    auto lookup = [&](int s) {
+        uint32_t bits = static_cast<uint32_t>(bitBuffer[s] >> (64 - ROOT_BITS));
+        if constexpr (Multi) {
+            const MultiEntry& entry = multiTable[bits];
+            if (entry.count > 0) {
+                std::memcpy(out[s], entry.symbols, MAX_MULTI_SYMBOLS);
+                out[s] += entry.count;
+                bitBuffer[s] <<= entry.length;
+                bitCount[s] -= entry.length;
+                return true;
+            }
+        }
+
+        const Entry* entry = &table[bits];
+        if (entry->kind == EntryKind::Sub) {
+            uint32_t wide = static_cast<uint32_t>(bitBuffer[s] >> (64 - ROOT_BITS - entry->length));
+            entry = &table[entry->value + (wide & ((1u << entry->length) - 1))];
+        }
+        if (entry->kind != EntryKind::Leaf) return false;
+
+        *out[s]++ = static_cast<unsigned char>(entry->value);
+        bitBuffer[s] <<= entry->length;
+        bitCount[s] -= entry->length;
+        return true;
+    };
+
+    bool fast = !singleSymbol;
+    while (fast) {
+        // Rounds every stream has output room and 8 readable input bytes for
+        size_t rounds = SIZE_MAX;
+        for (int s = 0; s < STREAMS; ++s) {
+            size_t bytesLeft = static_cast<size_t>(end[s] - cursor[s]);
+            rounds = std::min(rounds, static_cast<size_t>(outEnd[s] - out[s]) / PER_ROUND);
+            rounds = std::min(rounds, bytesLeft >= 8 ? (bytesLeft - 8) / 7 + 1 : 0);
+        }
+        if (rounds == 0) break;
+
+        for (size_t r = 0; r < rounds && fast; ++r) {
+            for (int s = 0; s < STREAMS; ++s) {
+                uint64_t word = 0;
+                for (int i = 0; i < 8; ++i) {
+                    word = (word << 8) | cursor[s][i];
+                }
+                bitBuffer[s] |= word >> bitCount[s];
+                cursor[s] += (63 - bitCount[s]) >> 3;
+                bitCount[s] |= 56;
+            }
+            for (int k = 0; k < LOOKUPS_PER_REFILL; ++k) {
+                for (int s = 0; s < STREAMS; ++s) {
+                    if (!lookup(s)) fast = false;  // A stalled stream stays put until the tail
+                }
+            }
+        }
+    }
+
+    // Streams end at different points (and very long codes need the slow path);
+    // finish each one with a reader positioned where the loop above stopped
+    for (int s = 0; s < STREAMS; ++s) {
+        size_t consumedBits = static_cast<size_t>(cursor[s] - streams[s]) * 8 - bitCount[s];
+        BitReader reader(streams[s] + consumedBits / 8, sizes[s] - consumedBits / 8);
+        uint32_t skipped;
+        if (consumedBits % 8 != 0 && !reader.readBits(static_cast<int>(consumedBits % 8), skipped)) return false;
+
+        size_t remaining = static_cast<size_t>(outEnd[s] - out[s]);
+        if (decode(reader, out[s], remaining) != remaining) return false;
+    }
+    return true;
+}
+
+// Bit-by-bit decoding for codes longer than ROOT_BITS + MAX_SUB_BITS
+bool DecodeTable::decodeSlow(BitReader& reader, unsigned char& symbol) const {
+    if (!root) return decodeCanonicalSlow(reader, symbol);
+
+    const HuffmanNode* current = root;
+    while (!current->isLeaf()) {
+        bool bit;
+        if (!reader.readBit(bit)) return false;
+        current = bit ? current->right : current->left;
+    }
+    symbol = current->byte;
+    return true;
+}
+
+// Canonical codes of one length are consecutive integers, so after each bit it
+// is enough to check whether the code read so far falls inside that length's run
+bool DecodeTable::decodeCanonicalSlow(BitReader& reader, unsigned char& symbol) const {
+    uint64_t code = 0;   // Bits read so far
+    uint64_t first = 0;  // First code of the current length
+    size_t index = 0;    // Position of that code in sortedSymbols
+
+    for (int length = 1; length <= CanonicalCode::MAX_CODE_LENGTH; ++length) {
+        bool bit;
+        if (!reader.readBit(bit)) return false;
+        code |= bit;
+
+        uint64_t count = lengthCount[length];
+        if (code - first < count) {
+            symbol = sortedSymbols[index + (code - first)];
+            return true;
+        }
+
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return false;  // Not a valid code
+}
@@ -1,11 +1,21 @@
 #include "decompressor.h"
 #include "huffmanTree.h"
+#include "decodeTable.h"
+#include "canonicalCode.h"
+#include "hpfFormat.h"
+#include "blockCodec.h"
+#include "threadPool.h"
+#include "inputSource.h"
 #include "config.h"
 
 #include <fstream>
 #include <iostream>
 #include <cstdint>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <future>
 
 void Decompressor::setLogger(LogCallback logCallback) {
     logger = logCallback;
@@ -15,6 +25,18 @@ void Decompressor::setProgressCallback(ProgressCallback progCallback) {
     progress = progCallback;
 }
 
+void Decompressor::setDecodeMode(DecodeMode mode) {
+    decodeMode = mode;
+}
+
+void Decompressor::setMaxOutputSize(uint64_t bytes) {
+    maxOutputSize = bytes;
+}
+
+void Decompressor::setThreadCount(unsigned count) {
+    threadCount = count;
+}
+
 Decompressor::~Decompressor() {
     freeTree(root);
 }
@@ -27,15 +49,10 @@ void Decompressor::freeTree(HuffmanNode* node) {
 }
 
 ErrorCode Decompressor::decompressFile(const std::string& inputFilename, const std::string& outputFilename) {
-    // Reset state from previous runs
-    if (root) {
-        freeTree(root);
-        root = nullptr;
-    }
-    originalFileSize = 0;
+    resetState();
 
-    std::ifstream input(inputFilename, std::ios::binary);
-    if (!input.is_open()) {
+    InputSource input;
+    if (input.open(inputFilename) != ErrorCode::Success) {
         if (logger) logger("Failed to open compressed input file: " + inputFilename + "\n");
         return ErrorCode::FileNotFound;
     }
@@ -48,7 +65,135 @@ ErrorCode Decompressor::decompressFile(const std::string& inputFilename, const s
 
     BitReader reader(input);
 
-    // Step 1: Deserialize Huffman Tree
+    // Step 1: Identify the format
+    int version = readFormatVersion(reader);
+
+    // With a block index, runs of blocks are decoded side by side straight into
+    // their place in the output; otherwise the blocks are decoded as they come
+    ErrorCode result;
+    unsigned threads = threadCount > 0 ? threadCount : ThreadPool::hardwareThreads();
+    std::vector<BlockIndexEntry> index;
+    if (version == HPF_VERSION_BLOCKS && threads > 1) {
+        std::ifstream indexInput(inputFilename, std::ios::binary);
+        if (!BlockCodec::readIndex(indexInput, index)) index.clear();
+    }
+    if (index.size() > 1) {
+        output.close();
+        result = decodeBlocksParallel(inputFilename, input.data(), outputFilename, index, threads);
+        if (result == ErrorCode::Success && logger) {
+            std::stringstream ss;
+            ss << "Decoded " << originalFileSize << " bytes\n";
+            logger(ss.str());
+        }
+    } else {
+        // Step 2: Load the code description and decode
+        result = decodeStream(version, reader, output, input.size());
+    }
+
+    if (result == ErrorCode::Success && logger) {
+        logger("Decompression complete. Output saved at: " + outputFilename + "\n");
+    }
+    return result;
+}
+
+ErrorCode Decompressor::decompress(std::istream& input, std::ostream& output) {
+    resetState();
+
+    BitReader reader(input);
+    ErrorCode result = decodeStream(readFormatVersion(reader), reader, output, 0);
+    output.flush();
+
+    if (result == ErrorCode::Success && !output) {
+        if (logger) logger("Failed writing decompressed output.\n");
+        return ErrorCode::FileWriteError;
+    }
+    return result;
+}
+
+ErrorCode Decompressor::decompressBuffer(std::span<const std::byte> input, std::vector<std::byte>& output) {
+    output.clear();
+    MemoryOutputBuffer buffer(output);
+    return decodeBuffer(input, buffer, maxOutputSize);
+}
+
+ErrorCode Decompressor::decompressBuffer(std::span<const std::byte> input, std::span<std::byte> output,
+                                         size_t& written) {
+    MemoryOutputBuffer buffer(output);
+    ErrorCode result = decodeBuffer(input, buffer, 0);  // The span bounds it
+    written = buffer.size();
+
+    if (buffer.overflowed()) {
+        if (logger) logger("Decompressed data does not fit the output buffer.\n");
+        return ErrorCode::BufferTooSmall;
+    }
+    return result;
+}
+
+// Decodes straight from the caller's memory: block bodies are not copied
+ErrorCode Decompressor::decodeBuffer(std::span<const std::byte> input, MemoryOutputBuffer& buffer,
+                                     uint64_t outputLimit) {
+    resetState();
+
+    BitReader reader(reinterpret_cast<const unsigned char*>(input.data()), input.size());
+    std::ostream stream(&buffer);
+    return decodeStream(readFormatVersion(reader), reader, stream, input.size(), outputLimit);
+}
+
+void Decompressor::resetState() {
+    if (root) {
+        freeTree(root);
+        root = nullptr;
+    }
+    originalFileSize = 0;
+}
+
+// Decodes whatever follows the format header, front to back. With an
+// `outputLimit`, data that claims to be larger is rejected before it is decoded.
+ErrorCode Decompressor::decodeStream(int version, BitReader& reader, std::ostream& output,
+                                     uint64_t compressedSize, uint64_t outputLimit) {
+    if (version == HPF_VERSION_BLOCKS) {
+        ErrorCode result = decodeBlocks(reader, output, compressedSize, outputLimit);
+        if (result == ErrorCode::Success && logger) {
+            std::stringstream ss;
+            ss << "Decoded " << originalFileSize << " bytes\n";
+            logger(ss.str());
+        }
+        return result;
+    }
+
+    DecodeTable table;
+    ErrorCode result;
+    if (version == HPF_VERSION_LEGACY) {
+        result = readLegacyHeader(reader, table);
+    } else if (version == HPF_VERSION_CANONICAL) {
+        result = readCanonicalHeader(reader, table);
+    } else {
+        if (logger) logger("Unsupported or corrupted .hpf header.\n");
+        return ErrorCode::InvalidFormat;
+    }
+    if (result != ErrorCode::Success) return result;
+
+    if (logger) {
+        std::stringstream ss;
+        ss << "Original file size to decode: " << originalFileSize << " bytes\n";
+        logger(ss.str());
+    }
+
+    if (outputLimit > 0 && originalFileSize > outputLimit) {
+        if (logger) logger("Declared size exceeds the output limit.\n");
+        return ErrorCode::DecompressionFailed;
+    }
+
+    // A short result is an error, not a smaller file; output that could not be
+    // written is reported as such
+    if (!decode(reader, output, table, originalFileSize)) {
+        return output ? ErrorCode::DecompressionFailed : ErrorCode::FileWriteError;
+    }
+    return ErrorCode::Success;
+}
+
+// Version 1: pre-order tree followed by a 64-bit big-endian size
+ErrorCode Decompressor::readLegacyHeader(BitReader& reader, DecodeTable& table) {
     root = deserializeTree(reader);
     if (!root) {
         if (logger) logger("Tree deserialization failed. Possibly corrupted input.\n");
@@ -57,10 +202,6 @@ ErrorCode Decompressor::decompressFile(const std::string& inputFilename, const s
 
     if (logger) logger("Huffman Tree deserialized successfully.\n");
 
-    // Step 2: Align to byte boundary - REMOVED (Bit stream is now continuous)
-    // reader.alignToByte();
-
-    // Step 3: Read original file size
     uint64_t originalSize = 0;
     for (int i = 7; i >= 0; --i) {
         unsigned char sizeByte;
@@ -70,19 +211,29 @@ ErrorCode Decompressor::decompressFile(const std::string& inputFilename, const s
         }
         originalSize |= static_cast<uint64_t>(sizeByte) << (8 * i);
     }
-
     originalFileSize = originalSize;
 
-    if (logger) {
-        std::stringstream ss;
-        ss << "Original file size to decode: " << originalFileSize << " bytes\n";
-        logger(ss.str());
+    if (decodeMode != DecodeMode::TreeWalk) {
+        table.build(root, decodeMode == DecodeMode::MultiSymbol);
+    }
+    return ErrorCode::Success;
+}
+
+// Version 2: varint size followed by canonical code lengths
+ErrorCode Decompressor::readCanonicalHeader(BitReader& reader, DecodeTable& table) {
+    if (!readVarint(reader, originalFileSize)) {
+        if (logger) logger("Failed to read file size metadata.\n");
+        return ErrorCode::FileReadError;
     }
 
-    // Step 4: Decode
-    decode(reader, output, root, originalFileSize);
+    CodeLengths lengths;
+    if (!CanonicalCode::readLengths(reader, lengths) ||
+        !table.build(lengths, decodeMode == DecodeMode::MultiSymbol)) {
+        if (logger) logger("Code length table is corrupted.\n");
+        return ErrorCode::TreeDeserializationError;
+    }
 
-    if (logger) logger("Decompression complete. Output saved at: " + outputFilename + "\n");
+    if (logger) logger("Canonical code table loaded successfully.\n");
     return ErrorCode::Success;
 }
 
@@ -113,40 +264,361 @@ HuffmanNode* Decompressor::deserializeTree(BitReader& reader) {
     return new HuffmanNode(0, left, right);
 }
 
-void Decompressor::decode(BitReader& reader, std::ostream& output, HuffmanNode* root, uint64_t originalSize) {
-    HuffmanNode* current = root;
+// Reference decoder: follows one tree pointer per input bit
+static size_t decodeTreeWalk(BitReader& reader, const HuffmanNode* root, unsigned char* output, size_t count) {
+    if (root->isLeaf()) {
+        std::fill_n(output, count, root->byte);
+        return count;
+    }
+
+    const HuffmanNode* current = root;
+    size_t decoded = 0;
     bool bit;
+
+    while (decoded < count && reader.readBit(bit)) {
+        current = bit ? current->right : current->left;
+        if (current->isLeaf()) {
+            output[decoded++] = current->byte;
+            current = root;
+        }
+    }
+    return decoded;
+}
+
+// Returns false if the input ran out (or the output failed) before `originalSize` bytes
+bool Decompressor::decode(BitReader& reader, std::ostream& output, const DecodeTable& table, uint64_t originalSize) {
+    // Symbols are decoded into a chunk buffer and written out in bulk
+    const size_t CHUNK_SIZE = 64 * 1024; // 64KB
+    std::vector<unsigned char> chunk(CHUNK_SIZE);
     uint64_t bytesWritten = 0;
 
     // For progress reporting
     uint64_t lastReported = 0;
     const uint64_t reportInterval = originalSize / 100; // Report every 1% roughly
 
-    while (bytesWritten < originalSize && reader.readBit(bit)) {
-        current = bit ? current->right : current->left;
+    while (bytesWritten < originalSize) {
+        size_t wanted = static_cast<size_t>(std::min<uint64_t>(CHUNK_SIZE, originalSize - bytesWritten));
+        size_t decoded = 0;
+        switch (decodeMode) {
+            case DecodeMode::TreeWalk:
+                // Canonical files carry no tree; they always go through the table
+                decoded = root ? decodeTreeWalk(reader, root, chunk.data(), wanted)
+                               : table.decode(reader, chunk.data(), wanted);
+                break;
+            case DecodeMode::SingleSymbol: decoded = table.decode(reader, chunk.data(), wanted); break;
+            case DecodeMode::MultiSymbol:  decoded = table.decodeMulti(reader, chunk.data(), wanted); break;
+        }
 
-        if (current->isLeaf()) {
-            output.put(current->byte);
-            ++bytesWritten;
-            current = root;
+        output.write(reinterpret_cast<const char*>(chunk.data()), decoded);
+        bytesWritten += decoded;
 
-            if (progress && originalSize > 0) {
-                if (bytesWritten - lastReported >= reportInterval || bytesWritten == originalSize) {
-                    progress(static_cast<float>(bytesWritten) / originalSize * 100.0f);
-                    lastReported = bytesWritten;
-                }
+        if (progress && originalSize > 0) {
+            if (bytesWritten - lastReported >= reportInterval || bytesWritten == originalSize) {
+                progress(static_cast<float>(bytesWritten) / originalSize * 100.0f);
+                lastReported = bytesWritten;
             }
         }
+
+        if (decoded < wanted) break;  // Ran out of input
+        if (!output) break;           // Nowhere to put the rest
     }
 
     if (bytesWritten < originalSize) {
         if (logger) {
             std::stringstream ss;
-            ss << "Warning: Expected " << originalSize
+            ss << "Error: Expected " << originalSize
                << " bytes, but only decoded " << bytesWritten << " bytes.\n";
             logger(ss.str());
         }
+        return false;
+    }
+    return true;
+}
+
+// Version 3: a sequence of self-contained blocks ended by a marker
+ErrorCode Decompressor::decodeBlocks(BitReader& reader, std::ostream& output, uint64_t compressedSize,
+                                     uint64_t outputLimit) {
+    DecodeTable table;
+    bool haveTable = false;
+    std::vector<unsigned char> scratch;
+    std::vector<unsigned char> block;
+    uint64_t bytesRead = 5;  // Magic and version
+
+    while (true) {
+        BlockHeader header;
+        if (!BlockCodec::readHeader(reader, header)) {
+            if (logger) logger("Block header is corrupted or truncated.\n");
+            return ErrorCode::InvalidFormat;
+        }
+        if (header.flags == HPF_BLOCK_END) break;
+        if ((header.flags & HPF_BLOCK_REUSE_TABLE) && !haveTable) {
+            if (logger) logger("First block refers to a previous code table.\n");
+            return ErrorCode::InvalidFormat;
+        }
+        if (outputLimit > 0 && header.rawSize > outputLimit - originalFileSize) {
+            if (logger) logger("Blocks add up to more than the output limit.\n");
+            return ErrorCode::DecompressionFailed;
+        }
+
+        // A mapped input is decoded in place
+        const unsigned char* body;
+        if (!reader.readSpan(body, static_cast<size_t>(header.bodySize), scratch)) {
+            if (logger) logger("Compressed data ends in the middle of a block.\n");
+            return ErrorCode::FileReadError;
+        }
+
+        block.resize(static_cast<size_t>(header.rawSize));
+        if (!BlockCodec::decodeBody(header, body, block.data(), table,
+                                    decodeMode != DecodeMode::SingleSymbol)) {
+            if (logger) logger("Block data is corrupted.\n");
+            return ErrorCode::DecompressionFailed;
+        }
+        haveTable = true;
+
+        output.write(reinterpret_cast<const char*>(block.data()), block.size());
+        if (!output) break;
+        originalFileSize += header.rawSize;
+        bytesRead += header.bodySize;
+
+        if (progress && compressedSize > 0) {
+            progress(std::min(100.0f, static_cast<float>(bytesRead) / compressedSize * 100.0f));
+        }
+    }
+
+    if (!output) {
+        if (logger) logger("Failed writing decompressed output.\n");
+        return ErrorCode::FileWriteError;
+    }
+    if (progress) progress(100.0f);
+    return ErrorCode::Success;
+}
+
+// Opens an indexed (version 3) file and loads its block index
+ErrorCode Decompressor::loadBlockIndex(const std::string& inputFilename, std::ifstream& input,
+                                       std::vector<BlockIndexEntry>& index) {
+    input.open(inputFilename, std::ios::binary);
+    if (!input.is_open()) {
+        if (logger) logger("Failed to open compressed input file: " + inputFilename + "\n");
+        return ErrorCode::FileNotFound;
+    }
+
+    unsigned char header[sizeof(HPF_MAGIC) + 1] = {};
+    input.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!input || !std::equal(std::begin(HPF_MAGIC), std::end(HPF_MAGIC), header) ||
+        header[sizeof(HPF_MAGIC)] != HPF_VERSION_BLOCKS || !BlockCodec::readIndex(input, index)) {
+        if (logger) logger("File has no block index; it can only be decompressed as a whole.\n");
+        return ErrorCode::InvalidFormat;
+    }
+    input.clear();
+    return ErrorCode::Success;
+}
+
+ErrorCode Decompressor::readContentSize(const std::string& inputFilename, uint64_t& size) {
+    std::ifstream input;
+    std::vector<BlockIndexEntry> index;
+    ErrorCode result = loadBlockIndex(inputFilename, input, index);
+    if (result != ErrorCode::Success) return result;
+
+    size = 0;
+    for (const BlockIndexEntry& entry : index) {
+        size += entry.rawSize;
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode Decompressor::decompressRange(const std::string& inputFilename, uint64_t offset, uint64_t length,
+                                        const std::string& outputFilename) {
+    std::ifstream input;
+    std::vector<BlockIndexEntry> index;
+    ErrorCode result = loadBlockIndex(inputFilename, input, index);
+    if (result != ErrorCode::Success) return result;
+
+    std::ofstream output(outputFilename, std::ios::binary);
+    if (!output.is_open()) {
+        if (logger) logger("Failed to open output file: " + outputFilename + "\n");
+        return ErrorCode::FileCreateError;
+    }
+
+    // Where every block starts in the compressed and in the original data
+    std::vector<uint64_t> inputOffsets(index.size());
+    std::vector<uint64_t> outputOffsets(index.size());
+    uint64_t inputOffset = sizeof(HPF_MAGIC) + 1;
+    originalFileSize = 0;
+    for (size_t i = 0; i < index.size(); ++i) {
+        inputOffsets[i] = inputOffset;
+        outputOffsets[i] = originalFileSize;
+        inputOffset += index[i].storedSize;
+        originalFileSize += index[i].rawSize;
+    }
+
+    uint64_t rangeEnd = offset + std::min(length, originalFileSize - std::min(offset, originalFileSize));
+    size_t first = std::upper_bound(outputOffsets.begin(), outputOffsets.end(), offset) - outputOffsets.begin();
+    first = first > 0 ? first - 1 : 0;
+
+    const bool multiSymbol = decodeMode != DecodeMode::SingleSymbol;
+    DecodeTable table;
+    std::vector<unsigned char> stored;
+    std::vector<unsigned char> block;
+    BlockHeader header;
+    const unsigned char* body;
+
+    // A block that reuses a table needs only the table of the block that stored it
+    if (first < index.size() && offset < rangeEnd && (index[first].flags & HPF_BLOCK_REUSE_TABLE)) {
+        size_t owner = first;
+        while (owner > 0 && (index[owner].flags & HPF_BLOCK_REUSE_TABLE)) --owner;
+        input.seekg(static_cast<std::streamoff>(inputOffsets[owner]));
+        if (!BlockCodec::readIndexedBlock(input, index[owner], stored, header, body) ||
+            !BlockCodec::loadTable(header, body, table, multiSymbol)) {
+            if (logger) logger("Block data is corrupted.\n");
+            return ErrorCode::InvalidFormat;
+        }
     }
+
+    uint64_t written = 0;
+    input.seekg(static_cast<std::streamoff>(first < index.size() ? inputOffsets[first] : 0));
+    for (size_t i = first; i < index.size() && outputOffsets[i] < rangeEnd && offset < rangeEnd; ++i) {
+        if (!BlockCodec::readIndexedBlock(input, index[i], stored, header, body)) {
+            if (logger) logger("Block header is corrupted or truncated.\n");
+            return ErrorCode::InvalidFormat;
+        }
+
+        block.resize(static_cast<size_t>(header.rawSize));
+        if (!BlockCodec::decodeBody(header, body, block.data(), table, multiSymbol)) {
+            if (logger) logger("Block data is corrupted.\n");
+            return ErrorCode::DecompressionFailed;
+        }
+
+        uint64_t start = std::max(offset, outputOffsets[i]) - outputOffsets[i];
+        uint64_t end = std::min(rangeEnd, outputOffsets[i] + header.rawSize) - outputOffsets[i];
+        output.write(reinterpret_cast<const char*>(block.data() + start), end - start);
+        written += end - start;
+
+        if (progress && rangeEnd > offset) {
+            progress(static_cast<float>(written) / (rangeEnd - offset) * 100.0f);
+        }
+    }
+
+    if (!output) {
+        if (logger) logger("Failed writing decompressed output.\n");
+        return ErrorCode::FileWriteError;
+    }
+
+    if (logger) {
+        std::stringstream ss;
+        ss << "Extracted " << written << " bytes at offset " << offset << " of " << originalFileSize << "\n";
+        logger(ss.str());
+    }
+    return ErrorCode::Success;
+}
+
+// A block with its own table and the blocks after it that reuse that table:
+// the smallest unit that can be decoded without looking at anything else
+struct BlockSegment {
+    size_t first = 0, last = 0;  // Block range in the index, inclusive
+    uint64_t inputOffset = 0;
+    uint64_t outputOffset = 0;
+    uint64_t rawSize = 0;
+};
+
+// `mapped` is the whole input file when it is memory-mapped, or nullptr to read it
+// through a stream of this worker's own
+static ErrorCode decodeSegment(const std::string& inputFilename, const unsigned char* mapped,
+                               const std::string& outputFilename, const std::vector<BlockIndexEntry>& index,
+                               const BlockSegment& segment, bool multiSymbol) {
+    std::ifstream input;
+    if (!mapped) {
+        input.open(inputFilename, std::ios::binary);
+        if (!input.is_open()) return ErrorCode::FileReadError;
+        input.seekg(static_cast<std::streamoff>(segment.inputOffset));
+    }
+    std::fstream output(outputFilename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!output.is_open()) return ErrorCode::FileWriteError;
+    output.seekp(static_cast<std::streamoff>(segment.outputOffset));
+
+    DecodeTable table;
+    std::vector<unsigned char> stored;
+    std::vector<unsigned char> block;
+    uint64_t inputOffset = segment.inputOffset;
+
+    for (size_t i = segment.first; i <= segment.last; ++i) {
+        BlockHeader header;
+        const unsigned char* body;
+        bool valid = mapped ? BlockCodec::readIndexedBlock(mapped + inputOffset, index[i], header, body)
+                            : BlockCodec::readIndexedBlock(input, index[i], stored, header, body);
+        if (!valid) return ErrorCode::InvalidFormat;
+        inputOffset += index[i].storedSize;
+
+        block.resize(static_cast<size_t>(header.rawSize));
+        if (!BlockCodec::decodeBody(header, body, block.data(), table, multiSymbol)) {
+            return ErrorCode::DecompressionFailed;
+        }
+        output.write(reinterpret_cast<const char*>(block.data()), block.size());
+    }
+
+    output.flush();
+    return output ? ErrorCode::Success : ErrorCode::FileWriteError;
+}
+
+// Version 3 with a block index: every segment is decoded by a worker that
+// reads its own part of the input and writes its own part of the output
+ErrorCode Decompressor::decodeBlocksParallel(const std::string& inputFilename, const unsigned char* mapped,
+                                             const std::string& outputFilename,
+                                             const std::vector<BlockIndexEntry>& index, unsigned threads) {
+    std::vector<BlockSegment> segments;
+    uint64_t inputOffset = sizeof(HPF_MAGIC) + 1;
+    uint64_t outputOffset = 0;
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (!(index[i].flags & HPF_BLOCK_REUSE_TABLE)) {
+            segments.push_back({i, i, inputOffset, outputOffset, 0});
+        }
+        segments.back().last = i;
+        segments.back().rawSize += index[i].rawSize;
+        inputOffset += index[i].storedSize;
+        outputOffset += index[i].rawSize;
+    }
+
+    // Workers write at their offsets, so the file gets its final size up front
+    std::error_code ec;
+    std::filesystem::resize_file(outputFilename, outputOffset, ec);
+    if (ec) {
+        if (logger) logger("Failed to allocate output file: " + outputFilename + "\n");
+        return ErrorCode::FileWriteError;
+    }
+
+    if (logger) {
+        std::stringstream ss;
+        ss << "Decoding " << index.size() << " blocks in " << segments.size()
+           << " segment(s) on " << threads << " threads\n";
+        logger(ss.str());
+    }
+
+    const bool multiSymbol = decodeMode != DecodeMode::SingleSymbol;
+    std::vector<ErrorCode> results(segments.size(), ErrorCode::Success);
+    std::vector<std::future<void>> done;
+    done.reserve(segments.size());
+
+    ThreadPool pool(std::min<unsigned>(threads, static_cast<unsigned>(segments.size())));
+    for (size_t s = 0; s < segments.size(); ++s) {
+        done.push_back(pool.submit([&, s]() {
+            results[s] = decodeSegment(inputFilename, mapped, outputFilename, index, segments[s], multiSymbol);
+        }));
+    }
+
+    ErrorCode result = ErrorCode::Success;
+    for (size_t s = 0; s < segments.size(); ++s) {
+        done[s].get();
+        if (results[s] != ErrorCode::Success && result == ErrorCode::Success) result = results[s];
+        originalFileSize += segments[s].rawSize;
+        if (progress && outputOffset > 0) {
+            progress(static_cast<float>(originalFileSize) / outputOffset * 100.0f);
+        }
+    }
+
+    if (result != ErrorCode::Success) {
+        if (logger) logger("Block data is corrupted: " + getErrorMessage(result) + "\n");
+        return result;
+    }
+    return ErrorCode::Success;
 }
 
 uint64_t Decompressor::getOriginalFileSize() const {
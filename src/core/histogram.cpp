@@ -0,0 +1,31 @@
+#include "histogram.h"
+
+void Histogram::add(const unsigned char* data, size_t size) {
+    size_t i = 0;
+    for (; i + LANES <= size; i += LANES) {
+        lanes[0][data[i]]++;
+        lanes[1][data[i + 1]]++;
+        lanes[2][data[i + 2]]++;
+        lanes[3][data[i + 3]]++;
+    }
+    for (; i < size; ++i) {
+        lanes[0][data[i]]++;
+    }
+}
+
+// Element-wise sum over contiguous arrays; the compiler vectorizes this loop
+FrequencyTable Histogram::merge() const {
+    FrequencyTable total{};
+    for (const FrequencyTable& lane : lanes) {
+        for (size_t byte = 0; byte < total.size(); ++byte) {
+            total[byte] += lane[byte];
+        }
+    }
+    return total;
+}
+
+void Histogram::clear() {
+    for (FrequencyTable& lane : lanes) {
+        lane.fill(0);
+    }
+}
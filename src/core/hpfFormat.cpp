@@ -0,0 +1,54 @@
+#include "hpfFormat.h"
+
+void writeFormatHeader(BitWriter& writer, int version) {
+    for (unsigned char byte : HPF_MAGIC) {
+        writer.writeByte(byte);
+    }
+    writer.writeByte(static_cast<unsigned char>(version));
+}
+
+int readFormatVersion(BitReader& reader) {
+    // The magic and the version byte are looked at together before anything is
+    // consumed: a version 1 stream whose tree is a single 0xFE or 0xFF leaf also
+    // starts with 0xFF, and is then read from its first byte
+    int available;
+    uint64_t header = reader.peekWideBits(8 * (sizeof(HPF_MAGIC) + 1), available);
+    if (available < 8 * static_cast<int>(sizeof(HPF_MAGIC) + 1)) return HPF_VERSION_LEGACY;
+
+    for (size_t i = 0; i < sizeof(HPF_MAGIC); ++i) {
+        unsigned char byte = static_cast<unsigned char>(header >> (8 * (sizeof(HPF_MAGIC) - i)));
+        if (byte != HPF_MAGIC[i]) return HPF_VERSION_LEGACY;
+    }
+    int version = static_cast<unsigned char>(header);
+    if (version != HPF_VERSION_CANONICAL && version != HPF_VERSION_BLOCKS) return HPF_VERSION_LEGACY;
+
+    reader.consumeBits(available);
+    return version;
+}
+
+void writeVarint(BitWriter& writer, uint64_t value) {
+    while (value >= 0x80) {
+        writer.writeByte(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    writer.writeByte(static_cast<unsigned char>(value));
+}
+
+void writeVarint(std::vector<unsigned char>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+bool readVarint(BitReader& reader, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        unsigned char byte;
+        if (!reader.readByte(byte)) return false;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;  // More than 10 groups: corrupt
+}
@@ -1,24 +1,26 @@
 #include "huffmanTree.h"
 #include <queue>
 
-HuffmanNode::HuffmanNode(unsigned char b, int freq)
+HuffmanNode::HuffmanNode(unsigned char b, uint64_t freq)
     : byte(b), frequency(freq), left(nullptr), right(nullptr) {}
 
-HuffmanNode::HuffmanNode(int freq, HuffmanNode* l, HuffmanNode* r)
+HuffmanNode::HuffmanNode(uint64_t freq, HuffmanNode* l, HuffmanNode* r)
     : byte(0), frequency(freq), left(l), right(r) {}
 
 bool HuffmanNode::isLeaf() const {
     return !left && !right;
 }
 
-void HuffmanTree::build(const std::unordered_map<unsigned char, int>& freqMap) {
+void HuffmanTree::build(const FrequencyTable& frequencies) {
     auto cmp = [](HuffmanNode* a, HuffmanNode* b) {
         return a->frequency > b->frequency;
     };
     std::priority_queue<HuffmanNode*, std::vector<HuffmanNode*>, decltype(cmp)> pq(cmp);
 
-    for (const auto& [byte, freq] : freqMap) {
-        pq.push(new HuffmanNode(byte, freq));
+    for (int byte = 0; byte < 256; ++byte) {
+        if (frequencies[byte] > 0) {
+            pq.push(new HuffmanNode(static_cast<unsigned char>(byte), frequencies[byte]));
+        }
     }
 
     while (pq.size() > 1) {
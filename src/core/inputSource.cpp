@@ -0,0 +1,156 @@
+#include "inputSource.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+InputSource::~InputSource() {
+    close();
+}
+
+ErrorCode InputSource::open(const std::string& filename, Access access) {
+    close();
+
+    std::error_code ec;
+    if (std::filesystem::is_regular_file(filename, ec)) {
+        fileSize = std::filesystem::file_size(filename, ec);
+        sizeKnown = !ec;
+    }
+
+    // Empty files have nothing to map; mapping more than the address space can't work
+    if (sizeKnown && fileSize > 0 && fileSize <= std::numeric_limits<size_t>::max() &&
+        map(filename, access)) {
+        return ErrorCode::Success;
+    }
+
+    file.open(filename, std::ios::binary);
+    if (!file.is_open()) return ErrorCode::FileNotFound;
+    return ErrorCode::Success;
+}
+
+void InputSource::attach(std::istream& stream) {
+    close();
+    input = &stream;
+}
+
+void InputSource::attach(const unsigned char* data, size_t size) {
+    close();
+    mapped = data;
+    fileSize = size;
+    sizeKnown = true;
+}
+
+#ifdef _WIN32
+
+bool InputSource::map(const std::string& filename, Access access) {
+    DWORD flags = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | flags, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    HANDLE mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        return false;
+    }
+
+    fileHandle = handle;
+    mappingHandle = mapping;
+    mapped = static_cast<const unsigned char*>(view);
+    ownsMapping = true;
+    return true;
+}
+
+void InputSource::close() {
+    if (mapped && ownsMapping) UnmapViewOfFile(mapped);
+    if (mappingHandle) CloseHandle(static_cast<HANDLE>(mappingHandle));
+    if (fileHandle) CloseHandle(static_cast<HANDLE>(fileHandle));
+    mapped = nullptr;
+    ownsMapping = false;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+
+    if (file.is_open()) file.close();
+    file.clear();
+    input = &file;
+    fileSize = 0;
+    sizeKnown = false;
+    position = 0;
+}
+
+#else
+
+bool InputSource::map(const std::string& filename, Access access) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    void* view = mmap(nullptr, static_cast<size_t>(fileSize), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // The mapping keeps the file referenced
+    if (view == MAP_FAILED) return false;
+
+    // Hints only; failures are harmless
+    madvise(view, static_cast<size_t>(fileSize),
+            access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    madvise(view, static_cast<size_t>(fileSize), MADV_WILLNEED);
+
+    mapped = static_cast<const unsigned char*>(view);
+    ownsMapping = true;
+    return true;
+}
+
+void InputSource::close() {
+    if (mapped && ownsMapping) munmap(const_cast<unsigned char*>(mapped), static_cast<size_t>(fileSize));
+    mapped = nullptr;
+    ownsMapping = false;
+
+    if (file.is_open()) file.close();
+    file.clear();
+    input = &file;
+    fileSize = 0;
+    sizeKnown = false;
+    position = 0;
+}
+
+#endif
+
+size_t InputSource::next(const unsigned char*& chunk, size_t maxBytes) {
+    if (mapped) {
+        size_t count = static_cast<size_t>(std::min<uint64_t>(maxBytes, fileSize - position));
+        chunk = mapped + position;
+        position += count;
+        return count;
+    }
+
+    // Keep reading until the request is filled: pipes deliver data in small pieces
+    if (buffer.size() < maxBytes) buffer.resize(maxBytes);
+    size_t count = 0;
+    while (count < maxBytes && *input) {
+        input->read(reinterpret_cast<char*>(buffer.data() + count), maxBytes - count);
+        count += static_cast<size_t>(input->gcount());
+    }
+    chunk = buffer.data();
+    position += count;
+    return count;
+}
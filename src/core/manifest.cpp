@@ -0,0 +1,138 @@
+#include "manifest.h"
+#include "threadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+namespace fs = std::filesystem;
+
+// What one walking thread found, merged once the walk is done
+struct PartialManifest {
+    std::vector<ManifestEntry> files;
+    std::string names;
+};
+
+static int64_t toUnixNanoseconds(fs::file_time_type time) {
+    auto since = std::chrono::file_clock::to_sys(time).time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since).count();
+}
+
+// Lists the files of one directory into `partial` and its subdirectories into
+// `subdirectories`. Returns false if part of it could not be read.
+static bool listDirectory(const fs::path& root, const std::string& relative, PartialManifest& partial,
+                          std::vector<std::string>& subdirectories) {
+    std::error_code ec;
+    bool complete = true;
+    for (fs::directory_iterator it(relative.empty() ? root : root / fs::path(relative), ec), end;
+         !ec && it != end; it.increment(ec)) {
+        const fs::directory_entry& entry = *it;
+        std::string name = entry.path().filename().generic_string();
+        if (!relative.empty()) name = relative + '/' + name;
+
+        std::error_code entryError;
+        if (entry.is_directory(entryError) && !entry.is_symlink(entryError)) {
+            subdirectories.push_back(std::move(name));
+            continue;
+        }
+        if (!entry.is_regular_file(entryError)) continue;
+
+        uint64_t size = entry.file_size(entryError);
+        fs::file_time_type modified = entry.last_write_time(entryError);
+        if (entryError) {
+            complete = false;
+            continue;
+        }
+        partial.files.push_back({partial.names.size(), static_cast<uint32_t>(name.size()), size,
+                                 toUnixNanoseconds(modified)});
+        partial.names += name;
+    }
+    return complete && !ec;
+}
+
+ErrorCode Manifest::scan(const std::string& directory, unsigned threads) {
+    root = directory;
+    files.clear();
+    names.clear();
+    total = 0;
+
+    std::error_code ec;
+    if (!fs::is_directory(root, ec)) return ErrorCode::FileNotFound;
+
+    // Directories still to be listed, relative to the root. The walk is over
+    // when none are left and no thread is listing one.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::string> pending{std::string()};
+    unsigned listing = 0;
+    bool complete = true;
+
+    ThreadPool pool(threads);
+    std::vector<PartialManifest> partials(pool.size());
+    std::vector<std::future<void>> walkers;
+
+    for (PartialManifest& partial : partials) {
+        walkers.push_back(pool.submit([&]() {
+            std::vector<std::string> found;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                changed.wait(lock, [&]() { return !pending.empty() || listing == 0; });
+                if (pending.empty()) break;
+
+                std::string relative = std::move(pending.back());
+                pending.pop_back();
+                ++listing;
+                lock.unlock();
+
+                bool listed = listDirectory(root, relative, partial, found);
+
+                lock.lock();
+                --listing;
+                complete = complete && listed;
+                for (std::string& subdirectory : found) {
+                    pending.push_back(std::move(subdirectory));
+                }
+                found.clear();
+                changed.notify_all();
+            }
+        }));
+    }
+    for (std::future<void>& walker : walkers) {
+        walker.get();
+    }
+
+    // Merge in name order, rebuilding the name pool so it follows the entries
+    std::vector<std::pair<std::string_view, const ManifestEntry*>> order;
+    for (const PartialManifest& partial : partials) {
+        for (const ManifestEntry& entry : partial.files) {
+            order.emplace_back(std::string_view(partial.names).substr(entry.nameOffset, entry.nameLength), &entry);
+        }
+    }
+    std::sort(order.begin(), order.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    files.reserve(order.size());
+    for (const auto& [name, entry] : order) {
+        files.push_back({names.size(), entry->nameLength, entry->size, entry->modified});
+        names += name;
+        total += entry->size;
+    }
+    return complete ? ErrorCode::Success : ErrorCode::FileReadError;
+}
+
+const std::vector<ManifestEntry>& Manifest::entries() const {
+    return files;
+}
+
+std::string_view Manifest::name(const ManifestEntry& entry) const {
+    return std::string_view(names).substr(entry.nameOffset, entry.nameLength);
+}
+
+fs::path Manifest::path(const ManifestEntry& entry) const {
+    return root / fs::path(name(entry));
+}
+
+uint64_t Manifest::totalSize() const {
+    return total;
+}
@@ -0,0 +1,34 @@
+#include "memoryStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+MemoryOutputBuffer::MemoryOutputBuffer(std::vector<std::byte>& output)
+    : vector(&output) {}
+
+MemoryOutputBuffer::MemoryOutputBuffer(std::span<std::byte> output)
+    : fixed(output) {}
+
+std::streamsize MemoryOutputBuffer::xsputn(const char* data, std::streamsize count) {
+    const std::byte* bytes = reinterpret_cast<const std::byte*>(data);
+    size_t wanted = static_cast<size_t>(count);
+
+    if (vector) {
+        vector->insert(vector->end(), bytes, bytes + wanted);
+        written += wanted;
+        return count;
+    }
+
+    // A short count makes the stream set badbit
+    size_t stored = std::min(wanted, fixed.size() - written);
+    if (stored > 0) std::memcpy(fixed.data() + written, bytes, stored);
+    written += stored;
+    if (stored < wanted) full = true;
+    return static_cast<std::streamsize>(stored);
+}
+
+MemoryOutputBuffer::int_type MemoryOutputBuffer::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+    char c = traits_type::to_char_type(ch);
+    return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+}
@@ -0,0 +1,263 @@
+#include "streamCodec.h"
+#include "bitWriter.h"
+#include "hpfFormat.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Longest block header: flags byte and two 10-byte varints
+static const size_t MAX_HEADER_SIZE = 1 + 10 + 10;
+
+void CompressStream::setMaxCodeLength(int length) {
+    maxCodeLength = length;
+}
+
+void CompressStream::setBlockSize(size_t size) {
+    blockSize = std::clamp<size_t>(size, 1, BlockCodec::MAX_BLOCK_SIZE);
+}
+
+void CompressStream::setInterleaved(bool enabled) {
+    interleaved = enabled;
+}
+
+void CompressStream::reset() {
+    started = false;
+    finishing = false;
+    block.clear();
+    pending.clear();
+    pendingOffset = 0;
+    previousLengths.fill(0);
+    sharedTableBlocks = 0;
+    index.clear();
+    streamSize = 0;
+}
+
+ErrorCode CompressStream::update(std::span<const std::byte> input, std::span<std::byte> output,
+                                 size_t& consumed, size_t& produced) {
+    consumed = 0;
+    produced = 0;
+    if (finishing) return ErrorCode::CompressionFailed;  // No input after finish()
+
+    if (!started) {
+        BitWriter writer(pending);
+        writeFormatHeader(writer, HPF_VERSION_BLOCKS);
+        started = true;
+    }
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+    while (true) {
+        produced += drain(output.subspan(produced));
+        if (pendingOffset < pending.size()) break;  // Output is full
+
+        size_t available = input.size() - consumed;
+        if (block.empty() && available >= blockSize) {
+            // A whole block in the caller's buffer is coded where it is
+            encode(data + consumed, blockSize);
+            consumed += blockSize;
+            continue;
+        }
+
+        size_t taken = std::min(available, blockSize - block.size());
+        block.insert(block.end(), data + consumed, data + consumed + taken);
+        consumed += taken;
+        if (block.size() < blockSize) break;  // Input is used up
+
+        encode(block.data(), block.size());
+        block.clear();
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode CompressStream::finish(std::span<std::byte> output, size_t& produced, bool& done) {
+    if (!finishing) {
+        if (!started) {
+            BitWriter writer(pending);
+            writeFormatHeader(writer, HPF_VERSION_BLOCKS);
+            started = true;
+        }
+        if (!block.empty()) {
+            encode(block.data(), block.size());
+            block.clear();
+        }
+
+        uint64_t indexOffset = sizeof(HPF_MAGIC) + 1 + streamSize + 1;
+        BlockCodec::writeEndMarker(pending);
+        BlockCodec::writeIndex(index, indexOffset, pending);
+        finishing = true;
+    }
+
+    produced = drain(output);
+    done = pendingOffset == pending.size();
+    return ErrorCode::Success;
+}
+
+// Hands out as much pending output as fits
+size_t CompressStream::drain(std::span<std::byte> output) {
+    size_t count = std::min(output.size(), pending.size() - pendingOffset);
+    if (count > 0) std::memcpy(output.data(), pending.data() + pendingOffset, count);
+    pendingOffset += count;
+    if (pendingOffset == pending.size()) {
+        pending.clear();
+        pendingOffset = 0;
+    }
+    return count;
+}
+
+// Codes one block behind the pending output, with the same table reuse as the
+// single-threaded Compressor
+void CompressStream::encode(const unsigned char* data, size_t size) {
+    size_t start = pending.size();
+    BlockCodec::encodeBlock(data, size, maxCodeLength, interleaved, pending, &previousLengths);
+
+    uint64_t storedSize = pending.size() - start;
+    index.push_back({pending[start], size, storedSize});
+    streamSize += storedSize;
+
+    sharedTableBlocks = (pending[start] & HPF_BLOCK_REUSE_TABLE) ? sharedTableBlocks + 1 : 1;
+    if (sharedTableBlocks == BlockCodec::MAX_SHARED_TABLE_BLOCKS) previousLengths.fill(0);
+}
+
+// Bytes of the block header at the start of `data`, or 0 if it is not complete yet
+static size_t headerLength(const unsigned char* data, size_t size) {
+    if (size == 0) return 0;
+    if (data[0] == HPF_BLOCK_END) return 1;
+
+    size_t position = 1;
+    for (int field = 0; field < 2; ++field) {
+        size_t start = position;
+        while (true) {
+            if (position == size) return 0;
+            if (position - start == 10) return position;  // Overlong varint: let the parser reject it
+            if (!(data[position++] & 0x80)) break;
+        }
+    }
+    return position;
+}
+
+void DecompressStream::reset() {
+    state = State::Magic;
+    error = ErrorCode::Success;
+    staging.clear();
+    header = BlockHeader{};
+    haveTable = false;
+    block.clear();
+    blockOffset = 0;
+}
+
+bool DecompressStream::finished() const {
+    return state == State::Done && blockOffset == block.size();
+}
+
+ErrorCode DecompressStream::update(std::span<const std::byte> input, std::span<std::byte> output,
+                                   size_t& consumed, size_t& produced) {
+    consumed = 0;
+    produced = 0;
+    if (error != ErrorCode::Success) return error;
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+    while (true) {
+        produced += drain(output.subspan(produced));
+        if (blockOffset < block.size()) break;  // Output is full
+
+        size_t available = input.size() - consumed;
+        if (state == State::Done) {
+            consumed = input.size();  // The block index is not needed
+            break;
+        }
+        if (available == 0) break;
+
+        if (state == State::Magic) {
+            size_t taken = std::min(available, sizeof(HPF_MAGIC) + 1 - staging.size());
+            staging.insert(staging.end(), data + consumed, data + consumed + taken);
+            consumed += taken;
+            if (staging.size() < sizeof(HPF_MAGIC) + 1) break;
+
+            if (!std::equal(std::begin(HPF_MAGIC), std::end(HPF_MAGIC), staging.begin()) ||
+                staging[sizeof(HPF_MAGIC)] != HPF_VERSION_BLOCKS) {
+                return error = ErrorCode::InvalidFormat;
+            }
+            staging.clear();
+            state = State::BlockHeader;
+
+        } else if (state == State::BlockHeader) {
+            // Byte by byte, so no body bytes are taken along
+            staging.push_back(data[consumed++]);
+            if (headerLength(staging.data(), staging.size()) == 0) continue;
+
+            ErrorCode result = parseHeader();
+            if (result != ErrorCode::Success) return error = result;
+
+        } else {
+            size_t bodySize = static_cast<size_t>(header.bodySize);
+            if (staging.empty() && available >= bodySize) {
+                // The whole body is in the caller's buffer: decode it from there
+                ErrorCode result = decodeBlock(data + consumed, output, produced);
+                if (result != ErrorCode::Success) return error = result;
+                consumed += bodySize;
+                continue;
+            }
+
+            size_t taken = std::min(available, bodySize - staging.size());
+            staging.insert(staging.end(), data + consumed, data + consumed + taken);
+            consumed += taken;
+            if (staging.size() < bodySize) break;
+
+            ErrorCode result = decodeBlock(staging.data(), output, produced);
+            if (result != ErrorCode::Success) return error = result;
+        }
+    }
+    return ErrorCode::Success;
+}
+
+ErrorCode DecompressStream::parseHeader() {
+    BitReader reader(staging.data(), staging.size());
+    if (staging.size() > MAX_HEADER_SIZE || !BlockCodec::readHeader(reader, header)) {
+        return ErrorCode::InvalidFormat;
+    }
+    staging.clear();
+
+    if (header.flags == HPF_BLOCK_END) {
+        state = State::Done;
+        return ErrorCode::Success;
+    }
+    if ((header.flags & HPF_BLOCK_REUSE_TABLE) && !haveTable) return ErrorCode::InvalidFormat;
+    state = State::Body;
+    return ErrorCode::Success;
+}
+
+// Decodes a complete body straight into the caller's output when the block
+// fits, or into the block buffer to be handed out over the next calls
+ErrorCode DecompressStream::decodeBlock(const unsigned char* body, std::span<std::byte> output, size_t& produced) {
+    size_t rawSize = static_cast<size_t>(header.rawSize);
+    bool direct = output.size() - produced >= rawSize;
+    unsigned char* target;
+    if (direct) {
+        target = reinterpret_cast<unsigned char*>(output.data() + produced);
+    } else {
+        block.resize(rawSize);
+        blockOffset = 0;
+        target = block.data();
+    }
+
+    if (!BlockCodec::decodeBody(header, body, target, table)) {
+        block.clear();
+        return ErrorCode::DecompressionFailed;
+    }
+    if (direct) produced += rawSize;
+
+    haveTable = true;
+    staging.clear();
+    state = State::BlockHeader;
+    return ErrorCode::Success;
+}
+
+size_t DecompressStream::drain(std::span<std::byte> output) {
+    size_t count = std::min(output.size(), block.size() - blockOffset);
+    if (count > 0) std::memcpy(output.data(), block.data() + blockOffset, count);
+    blockOffset += count;
+    if (blockOffset == block.size()) {
+        block.clear();
+        blockOffset = 0;
+    }
+    return count;
+}
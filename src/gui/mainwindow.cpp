@@ -1,6 +1,7 @@
 #include "mainWindow.h"
 #include "errors.h"
 #include "huffmanTree.h"
+#include "manifest.h"
 #include <QThread>
 #include <QApplication>
 #include <QFileInfo>
@@ -104,6 +105,7 @@ void MainWindow::setupUI() {
     setMinimumSize(800, 600);
 
     // Threading Setup
+    qRegisterMetaType<std::shared_ptr<const Manifest>>();
     workerThread = new QThread(this);
     worker = new Worker();
     worker->moveToThread(workerThread);
@@ -341,13 +343,10 @@ uint64_t MainWindow::getPathSize(const QString& path) {
     }
     
     if (fs::is_directory(p)) {
-        uint64_t size = 0;
-        for (const auto& entry : fs::recursive_directory_iterator(p)) {
-            if (entry.is_regular_file()) {
-                size += entry.file_size();
-            }
-        }
-        return size;
+        // Same parallel walk the archiver uses; unreadable parts are left out
+        Manifest manifest;
+        manifest.scan(p);
+        return manifest.totalSize();
     }
     return 0;
 }
@@ -370,10 +369,21 @@ bool MainWindow::isTextFile(const QString& path) {
 }
 
 void MainWindow::updateSmartUI() {
+    selectedManifest.reset();
     if (selectedFilePath.isEmpty()) return;
 
     QFileInfo fi(selectedFilePath);
-    originalSize = getPathSize(selectedFilePath);
+    if (fi.isDir()) {
+        // The folder is walked once: the listing gives the size shown here and
+        // is handed to the archiver. A partial listing is not passed on, so
+        // the archiver walks the folder again and reports what it cannot read.
+        auto manifest = std::make_shared<Manifest>();
+        ErrorCode scanned = manifest->scan(selectedFilePath.toStdString());
+        originalSize = manifest->totalSize();
+        if (scanned == ErrorCode::Success) selectedManifest = manifest;
+    } else {
+        originalSize = getPathSize(selectedFilePath);
+    }
     
     // Update Drop Zone Text
     dropZone->setText("Selected:\n" + fi.fileName());
@@ -547,7 +557,7 @@ void MainWindow::startCompression() {
     
     setButtonsEnabled(false);
     saveButton->setVisible(false);
-    emit requestCompression(selectedFilePath, currentTempFile);
+    emit requestCompression(selectedFilePath, currentTempFile, isFolderMode ? selectedManifest : nullptr);
 }
 
 void MainWindow::startDecompression() {
@@ -39,7 +39,8 @@ private slots:
     void saveFile();
 
 signals:
-    void requestCompression(const QString& input, const QString& output);
+    void requestCompression(const QString& input, const QString& output,
+                            std::shared_ptr<const Manifest> manifest);
     void requestDecompression(const QString& input, const QString& output);
 
 private:
@@ -73,6 +74,7 @@ private:
     bool isCompressionMode;     // To know if we are saving a .huff or .decompressed
     bool isFolderMode;          // True if user selected "Compress Folder"
     uint64_t originalSize;
+    std::shared_ptr<const Manifest> selectedManifest;  // Listing of a selected folder, for the archiver
 
     QThread* workerThread;
     Worker* worker;
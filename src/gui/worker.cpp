@@ -2,60 +2,39 @@
 #include "errors.h"
 #include "archiver.h"
 #include <filesystem>
-#include <fstream>
 
 namespace fs = std::filesystem;
 
 Worker::Worker(QObject *parent) : QObject(parent) {}
 
-void Worker::processCompression(const QString& inputFile, const QString& outputFile) {
+void Worker::processCompression(const QString& inputFile, const QString& outputFile,
+                                std::shared_ptr<const Manifest> manifest) {
     try {
         std::string inputPath = inputFile.toStdString();
-        std::string finalInputPath = inputPath;
-        std::string tempArchivePath;
-        bool isDirectory = fs::is_directory(inputPath);
-
-        if (isDirectory) {
-            emit logMessage("Worker: Input is a directory. Archiving...");
-            tempArchivePath = inputPath + ".arch_temp";
-            ErrorCode archResult = Archiver::archiveDirectory(inputPath, tempArchivePath);
-            if (archResult != ErrorCode::Success) {
-                emit operationFinished(false, "Failed to archive directory.");
-                return;
-            }
-            finalInputPath = tempArchivePath;
-            emit logMessage("Worker: Archive created.");
-        }
-
-        Compressor compressor;
-        HuffmanTree tree;
-
-        compressor.setLogger([this](const std::string& msg) {
+        LogCallback logger = [this](const std::string& msg) {
             emit logMessage(QString::fromStdString(msg));
-        });
-
-        compressor.setProgressCallback([this](float p) {
+        };
+        ProgressCallback progress = [this](float p) {
             emit progressUpdated(p);
-        });
-
-        emit logMessage("Worker: Starting compression task...");
-        
-        if (compressor.readFileAndBuildFrequency(finalInputPath) != ErrorCode::Success) {
-            if (isDirectory) fs::remove(tempArchivePath);
-            emit operationFinished(false, "Failed to read input file.");
-            return;
-        }
-
-        tree.build(compressor.getFrequencyMap());
-        tree.generateCodes();
-
-        ErrorCode result = compressor.compressFile(finalInputPath, 
-                                                   outputFile.toStdString(), 
-                                                   tree.getHuffmanCodes(), 
-                                                   tree.getRoot());
+        };
+
+        ErrorCode result;
+        if (fs::is_directory(inputPath)) {
+            // Every file is compressed on its own, in parallel, straight into the archive
+            emit logMessage("Worker: Input is a directory. Compressing it into an archive...");
+            ArchiveOptions options;
+            options.logger = logger;
+            options.progress = progress;
+            // The folder is only walked again if the window has no listing of it
+            result = manifest ? Archiver::compressDirectory(*manifest, outputFile.toStdString(), options)
+                              : Archiver::compressDirectory(inputPath, outputFile.toStdString(), options);
+        } else {
+            Compressor compressor;
+            compressor.setLogger(logger);
+            compressor.setProgressCallback(progress);
 
-        if (isDirectory) {
-            fs::remove(tempArchivePath);
+            emit logMessage("Worker: Starting compression task...");
+            result = compressor.compress(inputPath, outputFile.toStdString());
         }
 
         if (result == ErrorCode::Success) {
@@ -82,57 +61,44 @@ void Worker::processDecompression(const QString& inputFile, const QString& outpu
             emit progressUpdated(p);
         });
 
-        emit logMessage("Worker: Starting decompression task...");
-        
-        // Decompress to a temp location first to check if it's an archive
-        std::string tempDecompPath = outputFile.toStdString() + ".tmp";
-        
-        ErrorCode result = decompressor.decompressFile(inputFile.toStdString(), tempDecompPath);
-
-        if (result != ErrorCode::Success) {
-            emit operationFinished(false, "Decompression failed with error code: " + QString::number((int)result));
-            return;
-        }
-
-        // Check if it's an archive
-        std::ifstream check(tempDecompPath, std::ios::binary);
-        char magic[8];
-        check.read(magic, 8);
-        check.close();
-
-        if (std::string(magic, 8) == "HUFFARCH") {
+        // Archives are extracted without a temporary copy: native ones member by
+        // member, earlier ones (a compressed bundle) by decoding straight into
+        // the extractor
+        std::string inPath = inputFile.toStdString();
+        std::string outPath = outputFile.toStdString();
+        if (Archiver::isNativeArchive(inPath) || Archiver::isLegacyArchive(inPath)) {
             emit logMessage("Worker: Detected archive. Extracting...");
-            // It's an archive, extract it
-            // For extraction, outputFile should be treated as a directory?
-            // The current UI flow expects a single file output. 
-            // We will extract to a folder named 'outputFile' (without extension if possible)
-            
-            // However, the UI passes a specific temp file path.
-            // Let's extract to a folder with that name.
-            
-            // Ensure output directory is clean
-            std::string outPath = outputFile.toStdString();
             if (fs::exists(outPath)) {
                 fs::remove_all(outPath);
             }
 
-            ErrorCode extractResult = Archiver::extractArchive(tempDecompPath, outPath);
-            fs::remove(tempDecompPath); // Clean up temp
-
+            ArchiveOptions options;
+            options.logger = [this](const std::string& msg) {
+                emit logMessage(QString::fromStdString(msg));
+            };
+            options.progress = [this](float p) {
+                emit progressUpdated(p);
+            };
+            ErrorCode extractResult = Archiver::extractArchive(inPath, outPath, options);
             if (extractResult == ErrorCode::Success) {
                 emit operationFinished(true, "Extraction successful! Ready to save.");
             } else {
                 emit operationFinished(false, "Extraction failed.");
             }
-        } else {
-            // Not an archive, just rename temp to final
-            std::string outPath = outputFile.toStdString();
-            if (fs::exists(outPath)) {
-                fs::remove_all(outPath);
-            }
-            fs::rename(tempDecompPath, outPath);
-            emit operationFinished(true, "Decompression successful! Ready to save.");
+            return;
+        }
+
+        emit logMessage("Worker: Starting decompression task...");
+        if (fs::exists(outPath)) {
+            fs::remove_all(outPath);
+        }
+
+        ErrorCode result = decompressor.decompressFile(inPath, outPath);
+        if (result != ErrorCode::Success) {
+            emit operationFinished(false, "Decompression failed with error code: " + QString::number((int)result));
+            return;
         }
+        emit operationFinished(true, "Decompression successful! Ready to save.");
 
     } catch (const std::exception& e) {
         emit operationFinished(false, QString("Critical Error: ") + e.what());
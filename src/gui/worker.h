@@ -6,6 +6,8 @@
 #include "compressor.h"
 #include "decompressor.h"
 #include "huffmanTree.h"
+#include "manifest.h"
+#include <memory>
 
 class Worker : public QObject
 {
@@ -15,7 +17,9 @@ public:
     explicit Worker(QObject *parent = nullptr);
 
 public slots:
-    void processCompression(const QString& inputFile, const QString& outputFile);
+    // `manifest`, if given, lists the input folder as the window scanned it
+    void processCompression(const QString& inputFile, const QString& outputFile,
+                            std::shared_ptr<const Manifest> manifest);
     void processDecompression(const QString& inputFile, const QString& outputFile);
 
 signals:
@@ -24,4 +28,6 @@ signals:
     void operationFinished(bool success, const QString& message);
 };
 
+Q_DECLARE_METATYPE(std::shared_ptr<const Manifest>)
+
 #endif // WORKER_H
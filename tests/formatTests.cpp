@@ -0,0 +1,253 @@
+// Regression checks for the .hpf formats, run by ctest
+#include "compressor.h"
+#include "decompressor.h"
+#include "streamCodec.h"
+#include "hpfFormat.h"
+
+#include <cstddef>
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+        ++failures;
+    }
+}
+
+// A version 1 file of 3000 bytes of 0xFF, as HuffPressor 1.0 wrote it: the tree
+// is a single 0xFF leaf, so the file starts with the first byte of HPF_MAGIC
+static void singleSymbolLegacyFile() {
+    const unsigned char file[] = {0xFF, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xDC, 0x00};
+    std::vector<std::byte> input(reinterpret_cast<const std::byte*>(file),
+                                 reinterpret_cast<const std::byte*>(file) + sizeof(file));
+
+    Decompressor decompressor;
+    std::vector<std::byte> output;
+    check(decompressor.decompressBuffer(input, output) == ErrorCode::Success,
+          "single 0xFF leaf version 1 file decodes");
+    check(output == std::vector<std::byte>(3000, std::byte{0xFF}), "single 0xFF leaf version 1 file round-trips");
+}
+
+// "abracadabra " 20 times as a version 1 file; cut short, it must fail rather
+// than give back fewer bytes
+static void truncatedLegacyFile() {
+    const unsigned char file[] = {
+        0x58, 0x49, 0x05, 0xC8, 0xB2, 0x58, 0xEC, 0x40, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x1E, 0x0F, 0x5A, 0xC7, 0xA8, 0xF5, 0xAC, 0x7A, 0x8F, 0x5A,
+        0xC7, 0xA8, 0xF5, 0xAC, 0x7A, 0x8F, 0x5A, 0xC7, 0xA8, 0xF5, 0xAC, 0x7A,
+        0x8F, 0x5A, 0xC7, 0xA8, 0xF5, 0xAC, 0x7A, 0x8F, 0x5A, 0xC7, 0xA8, 0xF5,
+        0xAC, 0x7A, 0x8F, 0x5A, 0xC7, 0xA8, 0xF5, 0xAC, 0x7A, 0x8F, 0x5A, 0xC7,
+        0xA8, 0xF5, 0xAC, 0x7A, 0x8F, 0x5A, 0xC7, 0xA8, 0xF5, 0xAC, 0x7A, 0x8F,
+        0x5A, 0xC7, 0xA8, 0xF5, 0xAC, 0x7A, 0x8F, 0x5A, 0xC7, 0xA8, 0xF5, 0xAC,
+        0x7A, 0x80,
+    };
+    const std::string original = [] {
+        std::string text;
+        for (int i = 0; i < 20; ++i) text += "abracadabra ";
+        return text;
+    }();
+    const std::byte* bytes = reinterpret_cast<const std::byte*>(file);
+
+    Decompressor decompressor;
+    std::vector<std::byte> output;
+    check(decompressor.decompressBuffer({bytes, sizeof(file)}, output) == ErrorCode::Success &&
+              std::string(reinterpret_cast<const char*>(output.data()), output.size()) == original,
+          "complete version 1 file decodes");
+    check(decompressor.decompressBuffer({bytes, 40}, output) == ErrorCode::DecompressionFailed,
+          "truncated version 1 buffer fails");
+
+    std::istringstream input(std::string(reinterpret_cast<const char*>(file), 40));
+    std::ostringstream restored;
+    check(decompressor.decompress(input, restored) == ErrorCode::DecompressionFailed,
+          "truncated version 1 stream fails");
+}
+
+// A version 1 file whose single-leaf tree needs no payload bits, with a forged
+// size of 2^40 bytes: decoding into a vector must fail instead of allocating it
+static void forgedLegacySize() {
+    const unsigned char file[] = {0xFF, 0x80, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00};
+    const std::byte* bytes = reinterpret_cast<const std::byte*>(file);
+
+    Decompressor decompressor;
+    std::vector<std::byte> output;
+    check(decompressor.decompressBuffer({bytes, sizeof(file)}, output) == ErrorCode::DecompressionFailed &&
+              output.empty(),
+          "forged version 1 size is rejected");
+
+    decompressor.setMaxOutputSize(1000);
+    const unsigned char small[] = {0xFF, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0xDC, 0x00};
+    check(decompressor.decompressBuffer({reinterpret_cast<const std::byte*>(small), sizeof(small)}, output) ==
+              ErrorCode::DecompressionFailed,
+          "version 1 size above a set limit is rejected");
+}
+
+// Input of one repeated byte has a one-entry code table and no payload bits,
+// whatever its length
+static void constantInput() {
+    const size_t sizes[] = {3000, 5 * 1024 * 1024};
+    for (size_t size : sizes) {
+        const std::vector<std::byte> original(size, std::byte{0xFF});
+
+        Compressor compressor;
+        std::vector<std::byte> compressed;
+        check(compressor.compressBuffer(original, compressed) == ErrorCode::Success,
+              "constant input compresses");
+        check(compressed.size() < 128, "constant input compresses to a few bytes per block");
+
+        Decompressor decompressor;
+        std::vector<std::byte> restored;
+        check(decompressor.decompressBuffer(compressed, restored) == ErrorCode::Success && restored == original,
+              "constant input round-trips");
+
+        decompressor.setMaxOutputSize(size - 1);
+        check(decompressor.decompressBuffer(compressed, restored) == ErrorCode::DecompressionFailed,
+              "blocks above the output limit are rejected");
+    }
+}
+
+// Text that changes slowly from block to block, so some blocks keep the table
+// of the block before them and others store a new one
+static std::vector<std::byte> sampleText(size_t size) {
+    static const char* words[] = {"status", "request", "timeout", "value", "index", "stream", "error", "data"};
+    std::vector<std::byte> text;
+    unsigned state = 1;
+    while (text.size() < size) {
+        state = state * 1103515245 + 12345;
+        std::string line = std::string(words[(state >> 16) % 8]) + " " + std::to_string((state >> 8) % 1000) +
+                           (text.size() % 40000 < 20000 ? ";\n" : " {QZXJ}\n");
+        for (char c : line) text.push_back(static_cast<std::byte>(c));
+    }
+    text.resize(size);
+    return text;
+}
+
+// Feeds `input` to a CompressStream in slices of `inputStep` bytes with
+// `outputStep` bytes of output room per call
+static std::vector<std::byte> compressInSlices(const std::vector<std::byte>& input, size_t blockSize,
+                                               size_t inputStep, size_t outputStep) {
+    CompressStream stream;
+    stream.setBlockSize(blockSize);
+    std::vector<std::byte> output;
+    std::vector<std::byte> room(outputStep);
+
+    size_t position = 0;
+    while (position < input.size()) {
+        size_t consumed, produced;
+        std::span<const std::byte> slice(input.data() + position, std::min(inputStep, input.size() - position));
+        if (stream.update(slice, room, consumed, produced) != ErrorCode::Success) return {};
+        output.insert(output.end(), room.begin(), room.begin() + produced);
+        position += consumed;
+    }
+
+    bool done = false;
+    while (!done) {
+        size_t produced;
+        if (stream.finish(room, produced, done) != ErrorCode::Success) return {};
+        output.insert(output.end(), room.begin(), room.begin() + produced);
+    }
+    return output;
+}
+
+// Feeds `input` to a DecompressStream the same way; false if it fails or does not finish
+static bool decompressInSlices(const std::vector<std::byte>& input, size_t inputStep, size_t outputStep,
+                               std::vector<std::byte>& output) {
+    DecompressStream stream;
+    output.clear();
+    std::vector<std::byte> room(outputStep);
+
+    size_t position = 0;
+    while (!stream.finished()) {
+        size_t consumed, produced;
+        std::span<const std::byte> slice(input.data() + position, std::min(inputStep, input.size() - position));
+        if (stream.update(slice, room, consumed, produced) != ErrorCode::Success) return false;
+        output.insert(output.end(), room.begin(), room.begin() + produced);
+        position += consumed;
+        if (consumed == 0 && produced == 0) return stream.finished();  // Input ran out
+    }
+    return true;
+}
+
+// CompressStream and DecompressStream fed in fragments as small as one byte:
+// block headers and bodies split across calls, blocks that reuse a table, and
+// output handed out a byte at a time, all matching the one-shot buffer API
+static void streamCodecFragments() {
+    const size_t blockSize = 16 * 1024;
+    const std::vector<std::byte> original = sampleText(300 * 1024);
+
+    Compressor compressor;
+    compressor.setThreadCount(1);
+    compressor.setBlockSize(blockSize);
+    std::vector<std::byte> expected;
+    check(compressor.compressBuffer(original, expected) == ErrorCode::Success, "buffer compression succeeds");
+
+    std::istringstream indexed(std::string(reinterpret_cast<const char*>(expected.data()), expected.size()));
+    std::vector<BlockIndexEntry> index;
+    check(BlockCodec::readIndex(indexed, index) && index.size() > 1 &&
+              std::any_of(index.begin(), index.end(),
+                          [](const BlockIndexEntry& entry) { return entry.flags & HPF_BLOCK_REUSE_TABLE; }) &&
+              std::count_if(index.begin(), index.end(),
+                            [](const BlockIndexEntry& entry) { return !(entry.flags & HPF_BLOCK_REUSE_TABLE); }) > 1,
+          "sample has several blocks, some reusing a table");
+
+    check(compressInSlices(original, blockSize, 1, 1) == expected, "compress stream fed byte by byte");
+    check(compressInSlices(original, blockSize, 5000, 7) == expected, "compress stream with little output room");
+    check(compressInSlices(original, blockSize, original.size(), 1 << 20) == expected,
+          "compress stream in one call");
+
+    std::vector<std::byte> restored;
+    check(decompressInSlices(expected, 1, 1, restored) && restored == original,
+          "decompress stream fed byte by byte");
+    check(decompressInSlices(expected, 3, 5000, restored) && restored == original,
+          "decompress stream with headers split across calls");
+    check(decompressInSlices(expected, expected.size(), 1 << 20, restored) && restored == original,
+          "decompress stream in one call");
+
+    Decompressor decompressor;
+    check(decompressor.decompressBuffer(expected, restored) == ErrorCode::Success && restored == original,
+          "buffer decompression matches");
+
+    // Cut before the end marker, the stream never finishes
+    std::vector<std::byte> truncated(expected.begin(), expected.begin() + expected.size() / 2);
+    check(!decompressInSlices(truncated, 1, 1, restored), "truncated stream does not finish");
+}
+
+// A corrupted stream fails, and keeps failing however it is fed afterwards
+static void streamCodecStickyError() {
+    Compressor compressor;
+    std::vector<std::byte> valid;
+    compressor.compressBuffer(sampleText(1000), valid);
+
+    // Valid magic and version, then a block header with an unknown flag
+    std::vector<std::byte> corrupted(valid.begin(), valid.begin() + sizeof(HPF_MAGIC) + 1);
+    for (unsigned char byte : {0x40, 0x01, 0x01}) corrupted.push_back(static_cast<std::byte>(byte));
+
+    DecompressStream stream;
+    std::vector<std::byte> room(4096);
+    size_t consumed, produced;
+    check(stream.update(corrupted, room, consumed, produced) == ErrorCode::InvalidFormat,
+          "unknown block flag fails the stream");
+    check(stream.update(valid, room, consumed, produced) == ErrorCode::InvalidFormat && consumed == 0 &&
+              produced == 0,
+          "failed stream stays failed");
+
+    stream.reset();
+    check(stream.update(valid, room, consumed, produced) == ErrorCode::Success && stream.finished() &&
+              produced == 1000,
+          "reset stream decodes again");
+}
+
+int main() {
+    singleSymbolLegacyFile();
+    truncatedLegacyFile();
+    forgedLegacySize();
+    constantInput();
+    streamCodecFragments();
+    streamCodecStickyError();
+    return failures == 0 ? 0 : 1;
+}